@@ -0,0 +1,106 @@
+#pragma once
+#include "configure.h"
+
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "counterrandom.h"
+#include "qmc.h"
+#include "util.h"
+
+
+// Chance in percent of a roll activationRng(100) < threshold
+inline int ActivationPercent(double threshold) {
+	return static_cast<int>(std::min(std::max(std::ceil(threshold), 0.), 100.));
+}
+
+
+// Importance sampling of activation rolls: the odds of success are
+// multiplied by e^tilt, so rolls succeed more often for tilt > 0
+class ActivationTilt {
+public:
+	explicit ActivationTilt(double tilt) {
+		for (int percent = 0; percent <= 100; percent++) {
+			double p = percent / 100.;
+			double q = tiltProbability(p, tilt);
+			thresholds[percent] = std::ldexp(q, 32);
+			logWeights[percent][0] = percent < 100 ? std::log((1 - p) / (1 - q)) : 0;
+			logWeights[percent][1] = percent > 0 ? std::log(p / q) : 0;
+		}
+	}
+
+	// A roll succeeds if a uniform 32-bit number is below this
+	double threshold(int percent) const {
+		return thresholds[percent];
+	}
+
+	// Log likelihood ratio of an outcome, untilted over tilted
+	double logWeight(int percent, bool success) const {
+		return logWeights[percent][success];
+	}
+
+private:
+	std::array<double, 101> thresholds;
+	std::array<std::array<double, 2>, 101> logWeights;
+};
+
+
+// Activation rolls of one card, from QMC points while covered and from the
+// card's Philox stream otherwise
+class ActivationRandom {
+public:
+	void seed(uint64_t seed, uint64_t id, uint32_t card, bool complement,
+		const QmcPoints * qmc = nullptr, const ActivationTilt * tilt = nullptr) {
+		rng.seed(seed, id, CounterRandom::Purpose::Activation, card, complement);
+		this->qmc = qmc;
+		this->tilt = tilt;
+		this->card = card;
+		roll = 0;
+		logWeightSum = 0;
+		if (qmc) {
+			index = id / qmc->replicates();
+			replicate = static_cast<unsigned>(id % qmc->replicates());
+		}
+	}
+
+	// Uniform in [0, bound). QMC draws use multiply-shift instead of rejection to
+	// keep the points stratified, so each value is off by less than 2^-32.
+	uint32_t operator()(uint32_t bound) {
+		if (qmc && qmc->covers(roll)) {
+			uint32_t u = qmc->draw(index, replicate, card, roll++);
+			return static_cast<uint32_t>(static_cast<uint64_t>(u) * bound >> 32);
+		}
+		roll++;
+		return rng(bound);
+	}
+
+	// Whether a roll succeeds, (*this)(100) < threshold. With a tilt the roll
+	// is drawn tilted and the log likelihood ratio is added to logWeight().
+	bool activate(double threshold) {
+		if (!tilt) {
+			return (*this)(100) < threshold;
+		}
+		int percent = ActivationPercent(threshold);
+		uint32_t u = qmc && qmc->covers(roll) ? qmc->draw(index, replicate, card, roll) : rng();
+		roll++;
+		bool success = u < tilt->threshold(percent);
+		logWeightSum += tilt->logWeight(percent, success);
+		return success;
+	}
+
+	// Log likelihood ratio of the tilted rolls since seed()
+	double logWeight() const {
+		return logWeightSum;
+	}
+
+private:
+	CounterRandom rng;
+	const QmcPoints * qmc = nullptr;
+	const ActivationTilt * tilt = nullptr;
+	uint64_t index = 0;
+	unsigned replicate = 0;
+	uint32_t card = 0;
+	unsigned roll = 0;
+	double logWeightSum = 0;
+};
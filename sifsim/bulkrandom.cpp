@@ -0,0 +1,66 @@
+#include "bulkrandom.h"
+#if USE_SIMD_RANDOM && defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+
+// Same as pcg32(seed, stream)
+void BulkRandom::seed(uint64_t seed, uint64_t id, bool complement) {
+	mask = complement ? UINT32_MAX : 0;
+	for (size_t j = 0; j < LANES; j++) {
+		uint64_t stream = id * LANES + j;
+		increments[j] = stream << 1 | 1;
+		states[j] = (seed + increments[j]) * MULTIPLIER + increments[j];
+	}
+	pos = BUFFER_SIZE;
+}
+
+
+// pcg32 outputs the xsh-rr permutation of the state before each step
+void BulkRandom::fill() {
+	size_t i = 0;
+#if USE_SIMD_RANDOM && defined(__AVX2__)
+	static_assert(LANES == 8, "The AVX2 kernel steps 2x4 lanes");
+	const __m256i mulLo = _mm256_set1_epi64x(MULTIPLIER & UINT32_MAX);
+	const __m256i mulHi = _mm256_set1_epi64x(MULTIPLIER >> 32);
+	const __m256i mask32 = _mm256_set1_epi64x(UINT32_MAX);
+	const __m256i v32 = _mm256_set1_epi64x(32);
+	const __m256i evens = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+	__m256i s[2], inc[2];
+	for (int k = 0; k < 2; k++) {
+		s[k] = _mm256_load_si256(reinterpret_cast<const __m256i *>(&states[k * 4]));
+		inc[k] = _mm256_load_si256(reinterpret_cast<const __m256i *>(&increments[k * 4]));
+	}
+	for (; i < BUFFER_SIZE; i += LANES) {
+		for (int k = 0; k < 2; k++) {
+			__m256i x = _mm256_xor_si256(s[k], _mm256_srli_epi64(s[k], 18));
+			x = _mm256_and_si256(_mm256_srli_epi64(x, 27), mask32);
+			__m256i rot = _mm256_srli_epi64(s[k], 59);
+			x = _mm256_or_si256(_mm256_srlv_epi64(x, rot), _mm256_sllv_epi64(x, _mm256_sub_epi64(v32, rot)));
+			x = _mm256_permutevar8x32_epi32(x, evens);
+			_mm_store_si128(reinterpret_cast<__m128i *>(&buffer[i + k * 4]), _mm256_castsi256_si128(x));
+			// 64-bit multiply from 32-bit halves
+			__m256i cross = _mm256_add_epi64(
+				_mm256_mul_epu32(_mm256_srli_epi64(s[k], 32), mulLo),
+				_mm256_mul_epu32(s[k], mulHi));
+			__m256i next = _mm256_add_epi64(_mm256_mul_epu32(s[k], mulLo), _mm256_slli_epi64(cross, 32));
+			s[k] = _mm256_add_epi64(next, inc[k]);
+		}
+	}
+	for (int k = 0; k < 2; k++) {
+		_mm256_store_si256(reinterpret_cast<__m256i *>(&states[k * 4]), s[k]);
+	}
+#endif
+	for (; i < BUFFER_SIZE; i += LANES) {
+		for (size_t j = 0; j < LANES; j++) {
+			uint64_t s = states[j];
+			auto x = static_cast<uint32_t>((s ^ s >> 18) >> 27);
+			auto rot = static_cast<unsigned>(s >> 59);
+			buffer[i + j] = x >> rot | x << (-rot & 31);
+			states[j] = s * MULTIPLIER + increments[j];
+		}
+	}
+	pos = 0;
+}
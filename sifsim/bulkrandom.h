@@ -0,0 +1,48 @@
+#pragma once
+#include "configure.h"
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+
+// Random numbers drawn in bulk from LANES interleaved pcg32 streams.
+// After seed(seed, id), lane j is pcg32(seed, id * LANES + j) and the n-th
+// number returned is output n / LANES of lane n % LANES, so the sequence
+// doesn't depend on the buffer size or on which fill kernel is used.
+// A complemented sequence returns ~x for every x, for antithetic sampling.
+class BulkRandom {
+public:
+	typedef uint32_t result_type;
+	static constexpr size_t LANES = 8;
+	static constexpr size_t BUFFER_SIZE = BULK_RANDOM_BUFFER;
+	static_assert(BUFFER_SIZE > 0 && BUFFER_SIZE % LANES == 0, "BULK_RANDOM_BUFFER shall be a multiple of 8");
+
+	static constexpr result_type min() {
+		return 0;
+	}
+
+	static constexpr result_type max() {
+		return UINT32_MAX;
+	}
+
+	void seed(uint64_t seed, uint64_t id, bool complement = false);
+
+	result_type operator()() {
+		if (pos == BUFFER_SIZE) {
+			fill();
+		}
+		return buffer[pos++] ^ mask;
+	}
+
+private:
+	void fill();
+
+	static constexpr uint64_t MULTIPLIER = UINT64_C(6364136223846793005);
+
+	alignas(32) std::array<uint64_t, LANES> states;
+	alignas(32) std::array<uint64_t, LANES> increments;
+	alignas(32) std::array<uint32_t, BUFFER_SIZE> buffer;
+	size_t pos = BUFFER_SIZE;
+	result_type mask = 0;
+};
@@ -0,0 +1,45 @@
+#include "chartcache.h"
+#include "rapidjsonutil.h"
+#include <ctime>
+
+using namespace std;
+using namespace std::literals;
+
+
+shared_ptr<const ChartCache::ChartData> ChartCache::load(const char * path) {
+	auto stamp = fileStamp(path);
+	auto it = index.find(path);
+	if (it != index.end()) {
+		entries.splice(entries.begin(), entries, it->second);
+		if (stamp == it->second->stamp && !it->second->racy) {
+			return it->second->data;
+		}
+	}
+
+	auto now = static_cast<int64_t>(time(nullptr));
+	string content = readAll(CFileWrapper(path, "rb"));
+	uint64_t hash = hashFnv1a(content);
+	if (it != index.end()) {
+		auto & entry = *it->second;
+		entry.stamp = stamp;
+		entry.racy = stamp.mtime >= now - 1;
+		if (entry.hash == hash) {
+			return entry.data;
+		}
+		index.erase(it);
+		entries.pop_front();
+	}
+
+	auto livejson = ParseJsonString(content);
+	if (!livejson.IsArray()) {
+		throw JsonParseError("Invalid livejson file: "s + path);
+	}
+	auto data = make_shared<const ChartData>(LiveModel::processChart(LiveModel::loadNotes(livejson)));
+	entries.push_front({ path, stamp, stamp.mtime >= now - 1, hash, data });
+	index.emplace(path, entries.begin());
+	while (entries.size() > capacity) {
+		index.erase(entries.back().path);
+		entries.pop_back();
+	}
+	return data;
+}
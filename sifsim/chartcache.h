@@ -0,0 +1,40 @@
+#pragma once
+#include "configure.h"
+
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include "livemodel.h"
+#include "util.h"
+
+
+// LRU cache of parsed and processed livejson files, keyed by path.
+// A file whose modification time or size changed is read again, and
+// parsed again if its content hash changed too.
+class ChartCache {
+public:
+	using ChartData = LiveModel::ChartData;
+
+	explicit ChartCache(size_t capacity) : capacity(capacity) {}
+	ChartCache(const ChartCache &) = delete;
+	ChartCache & operator=(const ChartCache &) = delete;
+
+	std::shared_ptr<const ChartData> load(const char * path);
+
+private:
+	struct Entry {
+		std::string path;
+		FileStamp stamp;
+		// Modified within a second of being read, a later change may keep the stamp
+		bool racy;
+		uint64_t hash;
+		std::shared_ptr<const ChartData> data;
+	};
+
+	size_t capacity;
+	// Most recently used first
+	std::list<Entry> entries;
+	std::map<std::string, std::list<Entry>::iterator> index;
+};
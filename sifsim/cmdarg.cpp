@@ -3,6 +3,7 @@
 #include <iostream>
 #include <cstring>
 #include <cstdlib>
+#include <cmath>
 #include <limits>
 #include <cassert>
 
@@ -13,15 +14,65 @@ CmdArg g_cmdArg;
 
 void printUsage() {
 	cout << R"(Usage: sifsim [OPTION]... [FILE]
-Run LLSIF live score simulation.
+  or:  sifsim merge [--save-partial=FILE] PARTIAL...
+  or:  sifsim compare [OPTION]... FILE FILE...
+Run LLSIF live score simulation, or merge partial results of runs over
+adjacent iteration ranges.
+
+compare simulates every FILE with the same iterations, sharing hit judgments
+and the random numbers of each card position, and reports the mean score
+difference of each pair with its standard error and how often the first wins.
+Of the stopping options it takes -n, --target-se (applied to every
+difference) and --time-limit.
 
 With no FILE, or when FILE is -, read standard input.
 
   -n, --iters=NUM         run NUM simulations [default: )" MACRO_STRING(SIFSIM_DEFAULT_ITERS) R"(]
   -s, --seed=NUM          set random seed to NUM
       --skip-iters=NUM    skip NUM iterations before simulation
+      --save-partial=FILE save mergeable statistics to FILE
+      --checkpoint=FILE   save progress to FILE regularly
+      --checkpoint-interval=SEC
+                          save progress every SEC seconds [default: )" MACRO_STRING(CHECKPOINT_INTERVAL_SEC) R"(]
+      --resume            continue from the checkpoint FILE if it exists
       --threads=NUM       run in NUM theards [default: 0 (auto)]
+      --engine=NAME       simulation engine: auto, full, simple or exact
+                            [default: auto]; simple only supports immediate
+                            ScorePlus and perfect bonus ratio skills, exact
+                            the ScorePlus ones triggered by time, notes or
+                            combo, and auto uses exact unless options need
+                            simulations, -n, --seed and stopping options
+                            included
+      --antithetic        run iterations in pairs with complementary random
+                            numbers, NUM and --skip-iters shall be even
+      --control-variates  also report the mean corrected by covariates with
+                            known means (greats, skill activations)
+      --qmc=NUM           draw skill activations from NUM independently
+                            scrambled Sobol sequences (2, 4, 8 or 16), NUM
+                            and --skip-iters shall be multiples of it
+      --importance-tilt=NUM
+                          sample with the odds of skill activations times
+                            e^NUM and of greats times e^-NUM, and report
+                            statistics weighted by likelihood ratios with
+                            the 95% confidence intervals of both tails;
+                            negative NUM (e.g. -0.1) leans to low scores
+      --splitting=SCORE   estimate the chance of at least SCORE, even a tiny
+                            one, by copying lives on the way to it partway
+                            through; NUM lives run in systems of )" MACRO_STRING(SPLITTING_PARTICLES) R"(
+                            after a pilot of )" MACRO_STRING(SPLITTING_PILOT_ITERS) R"( plain ones
+      --threshold=SCORE   estimate the chance of at least SCORE, stopping each
+                            live once it has reached SCORE or can't anymore
+      --server            read jobs from standard input, one JSON object per
+                            line, and write one JSON result line per job
+      --batch             run the jobs in FILE like --server, many at a time
   -h, --help              display this help and exit
+
+Stopping options (-n sets the maximum, unlimited by default):
+      --target-se=NUM     stop when the standard error of Avg is at most NUM
+      --target-ci=NUM     stop when the 95% confidence interval of 0.1% is
+                            within NUM on both sides
+      --time-limit=SEC    stop after SEC seconds and report the simulations
+                            completed so far
 )";
 }
 
@@ -50,6 +101,18 @@ optional<int> strtoi(const char * str, int radix = 10) {
 }
 
 
+optional<double> strtodbl(const char * str) {
+	ErrNoGuard _e;
+	char * pend;
+	auto d = strtod(str, &pend);
+	if (pend == str) return nullopt;
+	if (errno == ERANGE) return nullopt;
+	if (*pend) return nullopt;
+	if (!isfinite(d)) return nullopt;
+	return d;
+}
+
+
 optional<uint64_t> strtou64(const char * str, int radix = 10) {
 	ErrNoGuard _e;
 	char * pend;
@@ -79,6 +142,12 @@ bool parseCmdArg(CmdArg & cmdArg, int argc, char * argv[]) {
 		}
 	};
 
+	// Long option name, optionally followed by "=ARG"
+	const auto matchLongOpt = [](const char * parg, const char * name) {
+		size_t len = strlen(name);
+		return strncmp(parg, name, len) == 0 && (parg[len] == '\0' || parg[len] == '=');
+	};
+
 	bool acceptOpt = true;
 	for (int i = 1; i < argc; i++) {
 		char * parg = argv[i];
@@ -118,20 +187,68 @@ bool parseCmdArg(CmdArg & cmdArg, int argc, char * argv[]) {
 			acceptOpt = false;
 			continue;
 
-		} else if (strcmp(parg, "help") == 0) {
+		} else if (matchLongOpt(parg, "antithetic")) {
+			cmdArg.antithetic = true;
+
+		} else if (matchLongOpt(parg, "batch")) {
+			cmdArg.batch = true;
+
+		} else if (matchLongOpt(parg, "control-variates")) {
+			cmdArg.controlVariates = true;
+
+		} else if (matchLongOpt(parg, "checkpoint")) {
+			haveArg = true;
+			pval = locateArg(isLongOpt, parg, i);
+			if (!pval) goto _noArg;
+			if (!*pval) goto _badArg;
+			cmdArg.checkpoint = pval;
+
+		} else if (matchLongOpt(parg, "checkpoint-interval")) {
+			haveArg = true;
+			pval = locateArg(isLongOpt, parg, i);
+			if (!pval) goto _noArg;
+			auto d = strtodbl(pval);
+			if (!d || !(*d > 0)) goto _badArg;
+			cmdArg.checkpointInterval = *d;
+
+		} else if (matchLongOpt(parg, "engine")) {
+			haveArg = true;
+			pval = locateArg(isLongOpt, parg, i);
+			if (!pval) goto _noArg;
+			if (strcmp(pval, "auto") == 0) {
+				cmdArg.engine = LiveEngine::Type::Auto;
+			} else if (strcmp(pval, "full") == 0) {
+				cmdArg.engine = LiveEngine::Type::Full;
+			} else if (strcmp(pval, "simple") == 0) {
+				cmdArg.engine = LiveEngine::Type::Simple;
+			} else if (strcmp(pval, "exact") == 0) {
+				cmdArg.engine = LiveEngine::Type::Exact;
+			} else {
+				goto _badArg;
+			}
+
+		} else if (matchLongOpt(parg, "help")) {
 		_help:
 			cmdArg.help = true;
 
-		} else if (strcmp(parg, "iters") == 0) {
+		} else if (matchLongOpt(parg, "importance-tilt")) {
+			haveArg = true;
+			pval = locateArg(isLongOpt, parg, i);
+			if (!pval) goto _noArg;
+			auto d = strtodbl(pval);
+			if (!d || !(*d != 0) || !(abs(*d) <= 10)) goto _badArg;
+			cmdArg.importanceTilt = *d;
+
+		} else if (matchLongOpt(parg, "iters")) {
 		_iters:
 			haveArg = true;
 			pval = locateArg(isLongOpt, parg, i);
 			if (!pval) goto _noArg;
-			auto n = strtoi(pval);
-			if (!n || *n <= 0) goto _badArg;
-			cmdArg.iters = *n;
+			auto u = strtou64(pval);
+			if (!u || *u == 0) goto _badArg;
+			cmdArg.iters = *u;
 
-		} else if (strcmp(parg, "seed") == 0) {
+		} else if (matchLongOpt(parg, "seed")) {
 		_seed:
 			haveArg = true;
 			pval = locateArg(isLongOpt, parg, i);
@@ -140,7 +257,36 @@ bool parseCmdArg(CmdArg & cmdArg, int argc, char * argv[]) {
 			if (!u) goto _badArg;
 			cmdArg.seed = *u;
 
-		} else if (strcmp(parg, "skip-iters") == 0) {
+		} else if (matchLongOpt(parg, "qmc")) {
+			haveArg = true;
+			pval = locateArg(isLongOpt, parg, i);
+			if (!pval) goto _noArg;
+			auto n = strtoi(pval);
+			if (!n || *n < 2) goto _badArg;
+			cmdArg.qmcReplicates = *n;
+
+		} else if (matchLongOpt(parg, "resume")) {
+			cmdArg.resume = true;
+
+		} else if (matchLongOpt(parg, "save-partial")) {
+			haveArg = true;
+			pval = locateArg(isLongOpt, parg, i);
+			if (!pval) goto _noArg;
+			if (!*pval) goto _badArg;
+			cmdArg.savePartial = pval;
+
+		} else if (matchLongOpt(parg, "server")) {
+			cmdArg.server = true;
+
+		} else if (matchLongOpt(parg, "splitting")) {
+			haveArg = true;
+			pval = locateArg(isLongOpt, parg, i);
+			if (!pval) goto _noArg;
+			auto n = strtoi(pval);
+			if (!n) goto _badArg;
+			cmdArg.splitting = *n;
+
+		} else if (matchLongOpt(parg, "skip-iters")) {
 			haveArg = true;
 			pval = locateArg(isLongOpt, parg, i);
 			if (!pval) goto _noArg;
@@ -148,7 +294,39 @@ bool parseCmdArg(CmdArg & cmdArg, int argc, char * argv[]) {
 			if (!u) goto _badArg;
 			cmdArg.skipIters = *u;
 
-		} else if (strcmp(parg, "threads") == 0) {
+		} else if (matchLongOpt(parg, "target-se")) {
+			haveArg = true;
+			pval = locateArg(isLongOpt, parg, i);
+			if (!pval) goto _noArg;
+			auto d = strtodbl(pval);
+			if (!d || !(*d > 0)) goto _badArg;
+			cmdArg.targetSe = *d;
+
+		} else if (matchLongOpt(parg, "target-ci")) {
+			haveArg = true;
+			pval = locateArg(isLongOpt, parg, i);
+			if (!pval) goto _noArg;
+			auto d = strtodbl(pval);
+			if (!d || !(*d > 0)) goto _badArg;
+			cmdArg.targetCi = *d;
+
+		} else if (matchLongOpt(parg, "time-limit")) {
+			haveArg = true;
+			pval = locateArg(isLongOpt, parg, i);
+			if (!pval) goto _noArg;
+			auto d = strtodbl(pval);
+			if (!d || !(*d > 0)) goto _badArg;
+			cmdArg.timeLimit = *d;
+
+		} else if (matchLongOpt(parg, "threshold")) {
+			haveArg = true;
+			pval = locateArg(isLongOpt, parg, i);
+			if (!pval) goto _noArg;
+			auto n = strtoi(pval);
+			if (!n || *n <= 0) goto _badArg;
+			cmdArg.threshold = *n;
+
+		} else if (matchLongOpt(parg, "threads")) {
 			haveArg = true;
 			pval = locateArg(isLongOpt, parg, i);
 			if (!pval) goto _noArg;
@@ -198,5 +376,7 @@ bool parseCmdArg(CmdArg & cmdArg, int argc, char * argv[]) {
 		return false;
 	}
 
+	cmdArg.samplingOptions = cmdArg.iters || cmdArg.skipIters || cmdArg.seed
+		|| cmdArg.targetSe || cmdArg.targetCi || cmdArg.timeLimit;
 	return true;
 }
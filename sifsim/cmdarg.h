@@ -5,14 +5,33 @@
 #include <string>
 #include <cstdint>
 #include "optional.h"
+#include "engine.h"
 
 
 struct CmdArg {
 	bool help = false;
-	optional<int> iters;
+	optional<uint64_t> iters;
 	uint64_t skipIters = 0;
 	optional<int> threads = nullopt;
 	optional<uint64_t> seed;
+	optional<double> targetSe;
+	optional<double> targetCi;
+	optional<double> timeLimit;
+	bool server = false;
+	bool batch = false;
+	optional<const char *> savePartial;
+	optional<const char *> checkpoint;
+	optional<double> checkpointInterval;
+	bool resume = false;
+	LiveEngine::Type engine = LiveEngine::Type::Auto;
+	bool antithetic = false;
+	bool controlVariates = false;
+	optional<int> qmcReplicates;
+	optional<double> importanceTilt;
+	optional<int> splitting;
+	optional<int> threshold;
+	// -n, --skip-iters, --seed or a stopping option was given
+	bool samplingOptions = false;
 	std::vector<char *> argumunts;
 };
 
@@ -37,6 +37,50 @@
 #endif
 #endif
 
+#ifndef USE_SIMD_RANDOM
+#define USE_SIMD_RANDOM 1
+#endif
+
+#ifndef BULK_RANDOM_BUFFER
+#define BULK_RANDOM_BUFFER 256
+#endif
+
 #ifndef USE_SSE_4_1_ROUND
 #define USE_SSE_4_1_ROUND 1
 #endif
+
+#ifndef SCHEDULER_CHUNK_ITERS
+#define SCHEDULER_CHUNK_ITERS 64
+#endif
+
+#ifndef CONVERGENCE_BATCH_ITERS
+#define CONVERGENCE_BATCH_ITERS 10000
+#endif
+
+#ifndef CHECKPOINT_INTERVAL_SEC
+#define CHECKPOINT_INTERVAL_SEC 60
+#endif
+
+#ifndef CHART_CACHE_SIZE
+#define CHART_CACHE_SIZE 64
+#endif
+
+#ifndef BATCH_JOB_WINDOW
+#define BATCH_JOB_WINDOW 256
+#endif
+
+#ifndef QMC_ROLLS_PER_CARD
+#define QMC_ROLLS_PER_CARD 64
+#endif
+
+#ifndef SPLITTING_PARTICLES
+#define SPLITTING_PARTICLES 1000
+#endif
+
+#ifndef SPLITTING_STAGES
+#define SPLITTING_STAGES 8
+#endif
+
+#ifndef SPLITTING_PILOT_ITERS
+#define SPLITTING_PILOT_ITERS 10000
+#endif
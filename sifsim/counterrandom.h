@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+
+// Counter-based random numbers (Philox4x32-10).
+// Stream (seed, id, purpose, sub) is the sequence of blocks
+// Philox(key = { seed & 0xffffffff, seed >> 32 },
+//        counter = { block, purpose << 24 | sub, id & 0xffffffff, id >> 32 }),
+// four numbers per block, so any draw can be reached without stepping through
+// the ones before it and streams don't shift when others draw more or less.
+// A complemented stream returns ~x for every x, and bound - 1 - r for bounded draws,
+// for antithetic sampling.
+class CounterRandom {
+public:
+	typedef uint32_t result_type;
+	typedef std::array<uint32_t, 4> Counter;
+	typedef std::array<uint32_t, 2> Key;
+
+	enum class Purpose : uint32_t {
+		Shuffle,
+		Activation,  // sub: card index
+		Sync,        // sub: card index
+		Scramble,    // sub: QMC dimension, id: replicate
+		Resample,    // sub: splitting stage, id: particle system
+	};
+
+	static constexpr uint32_t SUB_MAX = (UINT32_C(1) << 24) - 1;
+
+	// Round multipliers and key increments, shared with the lane kernels
+	static constexpr uint32_t M0 = UINT32_C(0xD2511F53);
+	static constexpr uint32_t M1 = UINT32_C(0xCD9E8D57);
+	static constexpr uint32_t W0 = UINT32_C(0x9E3779B9);
+	static constexpr uint32_t W1 = UINT32_C(0xBB67AE85);
+
+	static constexpr result_type min() {
+		return 0;
+	}
+
+	static constexpr result_type max() {
+		return UINT32_MAX;
+	}
+
+	static Counter philox(Counter ctr, Key key) {
+		for (int round = 0; round < 10; round++) {
+			if (round > 0) {
+				key[0] += W0;
+				key[1] += W1;
+			}
+			uint64_t p0 = static_cast<uint64_t>(M0) * ctr[0];
+			uint64_t p1 = static_cast<uint64_t>(M1) * ctr[2];
+			ctr = {
+				static_cast<uint32_t>(p1 >> 32) ^ ctr[1] ^ key[0],
+				static_cast<uint32_t>(p1),
+				static_cast<uint32_t>(p0 >> 32) ^ ctr[3] ^ key[1],
+				static_cast<uint32_t>(p0),
+			};
+		}
+		return ctr;
+	}
+
+	// Starts at draw 0 of the stream, sub shall be at most SUB_MAX
+	void seed(uint64_t seed, uint64_t id, Purpose purpose, uint32_t sub = 0, bool complement = false) {
+		this->complement = complement;
+		key = { static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32) };
+		counter = { 0, static_cast<uint32_t>(purpose) << 24 | sub,
+			static_cast<uint32_t>(id), static_cast<uint32_t>(id >> 32) };
+		pos = 4;
+	}
+
+	// Continues from draw index of the stream
+	void seek(uint64_t index) {
+		counter[0] = static_cast<uint32_t>(index >> 2);
+		pos = 4;
+		if (index & 3) {
+			next();
+			pos = index & 3;
+		}
+	}
+
+	result_type operator()() {
+		result_type r = next();
+		return complement ? ~r : r;
+	}
+
+	// Uniform in [0, bound), rejects like pcg32
+	result_type operator()(result_type bound) {
+		result_type threshold = (0u - bound) % bound;
+		for (;;) {
+			result_type r = next();
+			if (r >= threshold) {
+				r %= bound;
+				return complement ? bound - 1 - r : r;
+			}
+		}
+	}
+
+private:
+	result_type next() {
+		if (pos == 4) {
+			block = philox(counter, key);
+			counter[0]++;
+			pos = 0;
+		}
+		return block[pos++];
+	}
+
+	Key key = {};
+	Counter counter = {};
+	Counter block = {};
+	unsigned pos = 4;
+	bool complement = false;
+};
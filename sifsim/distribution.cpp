@@ -0,0 +1,102 @@
+#include "distribution.h"
+#include <cmath>
+#include <climits>
+#include <algorithm>
+
+using namespace std;
+
+
+void ScoreDistribution::addBinomial(int value, int n, double p) {
+	vector<pair<int, double>> outcomes;
+	if (!(p > 0) || n <= 0) {
+		outcomes.emplace_back(0, 1.);
+	} else if (!(p < 1)) {
+		outcomes.emplace_back(value * n, 1.);
+	} else {
+		double logP = log(p);
+		double logQ = log1p(-p);
+		double logN = lgamma(n + 1.);
+		for (int k = 0; k <= n; k++) {
+			double prob = exp(logN - lgamma(k + 1.) - lgamma(n - k + 1.) + k * logP + (n - k) * logQ);
+			// Far tails only widen the convolution, the ends are kept for the range
+			if (prob > EPSILON * EPSILON || k == 0 || k == n) {
+				outcomes.emplace_back(value * k, prob);
+			}
+		}
+	}
+	add(outcomes.data(), outcomes.data() + outcomes.size());
+}
+
+
+double ScoreDistribution::stddev() const {
+	return sqrt(std::max(varianceSum, 0.));
+}
+
+
+int ScoreDistribution::quantile(double q) const {
+	double sum = 0;
+	for (size_t i = 0; i < pmf.size(); i++) {
+		sum += pmf[i];
+		if (sum >= q) {
+			return offset + static_cast<int>(i);
+		}
+	}
+	return offset + static_cast<int>(pmf.size()) - 1;
+}
+
+
+void ScoreDistribution::add(const pair<int, double> * first, const pair<int, double> * last) {
+	int low = INT_MAX;
+	int high = INT_MIN;
+	for (auto it = first; it != last; ++it) {
+		if (it->second > 0) {
+			low = std::min(it->first, low);
+			high = std::max(it->first, high);
+		}
+	}
+	if (low > high) {
+		return;
+	}
+	// Moments about the lowest value
+	double m1 = 0;
+	double m2 = 0;
+	for (auto it = first; it != last; ++it) {
+		double d = it->first - low;
+		m1 += it->second * d;
+		m2 += it->second * d * d;
+	}
+	meanSum += low + m1;
+	varianceSum += m2 - m1 * m1;
+	minScore += low;
+	maxScore += high;
+
+	buffer.assign(pmf.size() + (high - low), 0.);
+	for (auto it = first; it != last; ++it) {
+		if (!(it->second > 0)) {
+			continue;
+		}
+		double p = it->second;
+		double * out = buffer.data() + (it->first - low);
+		for (size_t i = 0; i < pmf.size(); i++) {
+			out[i] += p * pmf[i];
+		}
+	}
+	pmf.swap(buffer);
+	offset += low;
+	trim();
+}
+
+
+void ScoreDistribution::trim() {
+	size_t begin = 0;
+	for (double sum = 0; begin + 1 < pmf.size() && (sum += pmf[begin]) < EPSILON; ) {
+		begin++;
+	}
+	size_t end = pmf.size();
+	for (double sum = 0; end > begin + 1 && (sum += pmf[end - 1]) < EPSILON; ) {
+		end--;
+	}
+	pmf.erase(pmf.begin() + end, pmf.end());
+	pmf.erase(pmf.begin(), pmf.begin() + begin);
+	offset += static_cast<int>(begin);
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "configure.h"
+
+#include <vector>
+#include <utility>
+#include <initializer_list>
+
+
+// Distribution of a sum of independent integer scores, built by convolving
+// them in one at a time. Mass below EPSILON at either end is dropped after
+// each step, so quantiles are exact but for far tails; the mean, SD, min and
+// max cover everything.
+class ScoreDistribution {
+public:
+	static constexpr double EPSILON = 1e-16;
+
+	// Adds a score taking each value with its probability
+	void add(std::initializer_list<std::pair<int, double>> outcomes) {
+		add(outcomes.begin(), outcomes.end());
+	}
+
+	// Adds value times the number of successes of n trials with chance p
+	void addBinomial(int value, int n, double p);
+
+	double mean() const {
+		return meanSum;
+	}
+
+	double stddev() const;
+
+	int min() const {
+		return minScore;
+	}
+
+	int max() const {
+		return maxScore;
+	}
+
+	// Smallest score whose cumulative probability is at least q
+	int quantile(double q) const;
+
+private:
+	void add(const std::pair<int, double> * first, const std::pair<int, double> * last);
+	void trim();
+
+	// pmf[i]: probability of offset + i
+	int offset = 0;
+	std::vector<double> pmf{ 1. };
+	std::vector<double> buffer;
+	double meanSum = 0;
+	double varianceSum = 0;
+	int minScore = 0;
+	int maxScore = 0;
+};
@@ -0,0 +1,44 @@
+#include "engine.h"
+#include <stdexcept>
+
+using namespace std;
+
+
+LiveEngine::LiveEngine(const LiveModel & model, Type type) {
+	if (!supports(model, type)) {
+		throw runtime_error(type == Type::Exact ? "The exact engine doesn't support this unit"
+			: "The simple engine doesn't support this unit");
+	}
+#if !SIMULATE_HIT_TIMING
+	if (type != Type::Full && SimpleLive::supports(model)) {
+		simple.emplace(model);
+		return;
+	}
+#endif
+	full.emplace(model);
+}
+
+
+bool LiveEngine::supports(const LiveModel & model, Type type) {
+	switch (type) {
+	case Type::Simple:
+#if SIMULATE_HIT_TIMING
+		return false;
+#else
+		return SimpleLive::supports(model);
+#endif
+	case Type::Exact:
+#if SIMULATE_HIT_TIMING
+		return false;
+#else
+		return SimpleLive::supportsDistribution(model);
+#endif
+	default:
+		return true;
+	}
+}
+
+
+LiveEngine::Type LiveEngine::type() const {
+	return full ? Type::Full : Type::Simple;
+}
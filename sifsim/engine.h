@@ -0,0 +1,118 @@
+#pragma once
+#include "configure.h"
+
+#include <cstdint>
+#include <cstddef>
+#include "optional.h"
+#include "livemodel.h"
+#include "live.h"
+#include "simplelive.h"
+#include "laneactivation.h"
+
+
+// Simulates a live with the fastest engine supporting its unit.
+// Every engine gives the same score for the same id and seed.
+class LiveEngine {
+public:
+	enum class Type {
+		Auto,
+		// Live, supports everything
+		Full,
+		// SimpleLive, immediate ScorePlus and perfect bonus ratio skills,
+		// LANES lives at a time
+		Simple,
+		// SimpleLive::distribution without simulating, immediate ScorePlus
+		// skills triggered by time, notes or combo only. Lives simulated
+		// one by one use SimpleLive.
+		Exact,
+	};
+
+	// Throws if the requested engine doesn't support the unit
+	LiveEngine(const LiveModel & model, Type type = Type::Auto);
+
+	static bool supports(const LiveModel & model, Type type);
+
+	// Lives simulated together by simulate(first, n, seed, results)
+	static constexpr size_t LANES = LaneActivations::LANES;
+
+	LiveResult simulate(uint64_t id, uint64_t seed) {
+#if !SIMULATE_HIT_TIMING
+		if (simple) {
+			return simple->simulate(id, seed);
+		}
+#endif
+		return full->simulate(id, seed);
+	}
+
+	// Lives [first, first + n) for n at most LANES, the same as simulate(id, seed) one by one
+	void simulate(uint64_t first, size_t n, uint64_t seed, LiveResult * results) {
+#if !SIMULATE_HIT_TIMING
+		if (simple) {
+			simple->simulate(first, n, seed, results);
+			return;
+		}
+#endif
+		for (size_t j = 0; j < n; j++) {
+			results[j] = full->simulate(first + j, seed);
+		}
+	}
+
+	// judgments shall come from a model shareable with this one
+	LiveResult simulate(uint64_t id, uint64_t seed, const HitJudgments & judgments) {
+#if !SIMULATE_HIT_TIMING
+		if (simple) {
+			return simple->simulate(id, seed, judgments);
+		}
+#endif
+		return full->simulate(id, seed, judgments);
+	}
+
+	void setAntithetic(bool value) {
+#if !SIMULATE_HIT_TIMING
+		if (simple) {
+			simple->setAntithetic(value);
+			return;
+		}
+#endif
+		full->setAntithetic(value);
+	}
+
+	void setQmc(const QmcPoints * points) {
+#if !SIMULATE_HIT_TIMING
+		if (simple) {
+			simple->setQmc(points);
+			return;
+		}
+#endif
+		full->setQmc(points);
+	}
+
+	void setTilt(double tilt) {
+#if !SIMULATE_HIT_TIMING
+		if (simple) {
+			simple->setTilt(tilt);
+			return;
+		}
+#endif
+		full->setTilt(tilt);
+	}
+
+	// SimpleLive scores a live in one pass and has nothing to cut short
+	void setThreshold(int threshold) {
+#if !SIMULATE_HIT_TIMING
+		if (simple) {
+			return;
+		}
+#endif
+		full->setThreshold(threshold);
+	}
+
+	// The engine in use, Full or Simple
+	Type type() const;
+
+private:
+	optional<Live> full;
+#if !SIMULATE_HIT_TIMING
+	optional<SimpleLive> simple;
+#endif
+};
@@ -93,6 +93,98 @@ namespace FastRandom {
 	};
 
 
+	// Geometric distribution: number of failures before the first success.
+	// Inversion with a 53-bit uniform, one log per sample.
+	// Requires 32+ bit UniformRandomBitGenerator
+	template <class IntType = uint64_t>
+	class GeometricDistribution {
+	public:
+		typedef IntType result_type;
+
+		struct param_type {
+			typedef GeometricDistribution distribution_type;
+
+			explicit param_type(double p = 0.5) {
+				_p = p;
+				_logq = std::log1p(-p);
+			}
+
+			bool operator ==(const param_type & b) const {
+				return _p == b._p;
+			}
+
+			bool operator !=(const param_type & b) const {
+				return !(*this == b);
+			}
+
+			double p() const {
+				return _p;
+			}
+
+			double _p;
+			double _logq;
+		};
+
+		explicit GeometricDistribution(double p = 0.5)
+			: _param(p) {
+		}
+
+		explicit GeometricDistribution(const param_type & param)
+			: _param(param) {
+		}
+
+		double p() const {
+			return _param.p();
+		}
+
+		param_type param() const {
+			return _param;
+		}
+
+		void param(const param_type & param) {
+			_param = param;
+		}
+
+		result_type(min)() const {
+			return 0;
+		}
+
+		result_type(max)() const {
+			return std::numeric_limits<result_type>::max();
+		}
+
+		void reset() {}
+
+		template<class Generator>
+		result_type operator()(Generator & g) const {
+			return _eval(g, _param);
+		}
+
+		template<class Generator>
+		result_type operator()(Generator & g, const param_type & param) const {
+			return _eval(g, param);
+		}
+
+	private:
+		template<class Generator>
+		result_type _eval(Generator & g, const param_type & param) const {
+			static_assert(Generator::min() == 0
+				&& Generator::max() >= std::numeric_limits<uint32_t>::max(),
+				"UniformRandomBitGenerator for FastRandom shall generate at least 32 bits per call");
+			constexpr double U_SCALE = 1. / (UINT64_C(1) << 53);
+			uint64_t r = static_cast<uint32_t>(g());
+			r = (r << 32 | static_cast<uint32_t>(g())) >> 11;
+			// u in (0, 1]
+			double u = (r + 1) * U_SCALE;
+			double x = std::floor(std::log(u) / param._logq);
+			constexpr double X_MAX = static_cast<double>(std::numeric_limits<result_type>::max() / 2);
+			return x < X_MAX ? static_cast<result_type>(x) : static_cast<result_type>(X_MAX);
+		}
+
+		param_type _param;
+	};
+
+
 	// Faster normal distribution (Ziggurat algorithm)
 	// Requires 32+ bit UniformRandomBitGenerator
 	template <class RealType = double>
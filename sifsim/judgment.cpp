@@ -0,0 +1,293 @@
+#include "judgment.h"
+#include "util.h"
+#include <cmath>
+#include <algorithm>
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+
+const auto compareTime = [](const auto & a, const auto & b) {
+	return a.time < b.time;
+};
+
+
+HitJudgments::HitJudgments(const LiveModel & model) {
+#if SIMULATE_HIT_TIMING
+	chartHits = model.chartHits;
+	holdEndHits.reserve(model.charts.size());
+	for (const auto & chart : model.charts) {
+		holdEndHits.emplace_back(chart.notes.size(), -1);
+	}
+#else
+	hitPerfects.reserve(model.chartHits.size());
+	for (const auto & hits : model.chartHits) {
+		hitPerfects.emplace_back((hits.size() + 63) / 64, ~UINT64_C(0));
+	}
+#endif
+	holdBeginPerfects.reserve(model.charts.size());
+	for (const auto & chart : model.charts) {
+		holdBeginPerfects.emplace_back(chart.notes.size(), true);
+	}
+	perfectMasks.reserve(model.chartHits.size());
+	starPerfectMasks.reserve(model.chartHits.size());
+	for (const auto & hits : model.chartHits) {
+		perfectMasks.emplace_back((hits.size() + 63) / 64);
+		starPerfectMasks.emplace_back((hits.size() + 63) / 64);
+	}
+}
+
+
+HitJudge::HitJudge(const LiveModel & model) : model(model) {
+#if SIMULATE_HIT_TIMING
+	eHit = model.eHit;
+	eHoldBegin = model.eHoldBegin;
+	eHoldEnd = model.eHoldEnd;
+	eSlide = model.eSlide;
+	holdBeginHitTimes.reserve(model.charts.size());
+	for (const auto & chart : model.charts) {
+		holdBeginHitTimes.emplace_back(chart.notes.size(), 0.);
+	}
+#else
+	greatGaps = model.greatGaps;
+#endif
+}
+
+
+void HitJudge::setTilt(double tilt) {
+#if SIMULATE_HIT_TIMING
+	// Timings are sampled as is, only skill activations get tilted
+	(void)tilt;
+#else
+	tilted = false;
+	for (int c = 0; c < LiveModel::HIT_CLASS_NUM; c++) {
+		double p = model.greatGaps[c].p();
+		double q = tiltProbability(p, -tilt);
+		greatGaps[c] = GeometricDistribution<>(q);
+		bool classTilted = p > 0 && p < 1 && q != p;
+		greatLogWeights[c] = { classTilted ? log((1 - p) / (1 - q)) : 0, classTilted ? log(p / q) : 0 };
+		tilted = tilted || classTilted;
+	}
+#endif
+}
+
+
+bool HitJudge::isShareable(const LiveModel & a, const LiveModel & b) {
+	if (&a == &b) {
+		return true;
+	}
+	const auto sameHit = [](const LiveModel::Hit & x, const LiveModel::Hit & y) {
+		return x.time == y.time && x.noteIndex == y.noteIndex
+			&& x.isHoldBegin == y.isHoldBegin && x.isHoldEnd == y.isHoldEnd && x.isSlide == y.isSlide;
+	};
+	if (a.chartHits.size() != b.chartHits.size()) {
+		return false;
+	}
+	for (size_t k = 0; k < a.chartHits.size(); k++) {
+		if (!equal(a.chartHits[k].begin(), a.chartHits[k].end(),
+			b.chartHits[k].begin(), b.chartHits[k].end(), sameHit)) {
+			return false;
+		}
+	}
+#if SIMULATE_HIT_TIMING
+	for (size_t k = 0; k < a.charts.size(); k++) {
+		const auto & x = a.charts[k].notes;
+		const auto & y = b.charts[k].notes;
+		if (!equal(x.begin(), x.end(), y.begin(), y.end(), [](const Note & m, const Note & n) {
+			return m.isBomb == n.isBomb;
+		})) {
+			return false;
+		}
+	}
+	return a.judgeOffset == b.judgeOffset
+		&& a.hitPerfectWindow == b.hitPerfectWindow && a.hitGreatWindow == b.hitGreatWindow
+		&& a.slidePerfectWindow == b.slidePerfectWindow && a.slideGreatWindow == b.slideGreatWindow
+		&& a.eHit.param() == b.eHit.param() && a.eHoldBegin.param() == b.eHoldBegin.param()
+		&& a.eHoldEnd.param() == b.eHoldEnd.param() && a.eSlide.param() == b.eSlide.param();
+#else
+	for (int c = 0; c < LiveModel::HIT_CLASS_NUM; c++) {
+		if (a.greatGaps[c].p() != b.greatGaps[c].p()) {
+			return false;
+		}
+	}
+	return a.chartStarMasks == b.chartStarMasks;
+#endif
+}
+
+
+#if !SIMULATE_HIT_TIMING
+void HitJudge::splice(const HitJudgments & from, size_t chart, int hit, HitJudgments & into) const {
+	for (size_t k = chart; k < model.charts.size(); k++) {
+		const auto & hits = model.chartHits[k];
+		int first = k == chart ? hit : 0;
+		for (int i = first; i < static_cast<int>(hits.size()); i++) {
+			if (testBit(from.hitPerfects[k], i)) {
+				setBit(into.hitPerfects[k], i);
+			} else {
+				resetBit(into.hitPerfects[k], i);
+			}
+			if (hits[i].isHoldBegin) {
+				into.holdBeginPerfects[k][hits[i].noteIndex] = from.holdBeginPerfects[k][hits[i].noteIndex];
+			}
+		}
+		// Hold ends count if their begins do, which may be before the splice
+		for (int i = first; i < static_cast<int>(hits.size()); i++) {
+			const auto & h = hits[i];
+			bool counted = testBit(model.chartPerfectMasks[k], i) && testBit(into.hitPerfects[k], i)
+				&& (!h.isHoldEnd || into.holdBeginPerfects[k][h.noteIndex]);
+			if (counted) {
+				setBit(into.perfectMasks[k], i);
+			} else {
+				resetBit(into.perfectMasks[k], i);
+			}
+			if (counted && testBit(model.chartStarMasks[k], i)) {
+				setBit(into.starPerfectMasks[k], i);
+			} else {
+				resetBit(into.starPerfectMasks[k], i);
+			}
+		}
+	}
+	into.logWeight = 0;
+	for (int c = 0; c < LiveModel::HIT_CLASS_NUM; c++) {
+		int greats = 0;
+		for (const auto & ref : model.classHits[c]) {
+			greats += !testBit(into.hitPerfects[ref.chart], ref.hit);
+		}
+		into.classGreats[c] = greats;
+		int perfects = static_cast<int>(model.classHits[c].size()) - greats;
+		into.logWeight += perfects * greatLogWeights[c][0] + greats * greatLogWeights[c][1];
+	}
+}
+#endif
+
+
+void HitJudge::judge(uint64_t id, uint64_t seed, HitJudgments & judgments) {
+	// Antithetic pairs 2k and 2k + 1 draw from the numbers of 2k
+	bool complement = antithetic && (id & 1);
+	if (antithetic) {
+		id &= ~UINT64_C(1);
+	}
+#if SIMULATE_HIT_TIMING
+	rng.seed(seed, id);
+	// Reflected about the mean, complemented bits wouldn't give an antithetic normal
+	const auto draw = [&](NormalDistribution<> & dist) {
+		double e = dist(rng);
+		return complement ? 2 * dist.mean() - e : e;
+	};
+	for (size_t k = 0; k < model.charts.size(); k++) {
+		const auto & notes = model.charts[k].notes;
+		const auto & baseHits = model.chartHits[k];
+		auto & hits = judgments.chartHits[k];
+		auto & holdBeginPerfect = judgments.holdBeginPerfects[k];
+		auto & holdBeginHitTime = holdBeginHitTimes[k];
+		// Draw in chart order, the sorted order of the previous iteration shouldn't matter
+		for (size_t i = 0; i < baseHits.size(); i++) {
+			auto & hit = hits[i];
+			hit = baseHits[i];
+			const auto & note = notes[hit.noteIndex];
+			double noteTime = hit.isHoldEnd ? note.holdEndTime : note.time;
+			double judgeTime = noteTime + model.judgeOffset;
+			double e;
+			if (hit.isHoldEnd) {
+				e = draw(eHoldEnd);
+			} else if (hit.isSlide) {
+				e = draw(eSlide);
+			} else if (hit.isHoldBegin) {
+				e = draw(eHoldBegin);
+			} else {
+				e = draw(eHit);
+			}
+			double greatWindow = hit.isSlide ? model.slideGreatWindow : model.hitGreatWindow;
+			if (!(fabs(e) < greatWindow)) {
+				e = copysign(greatWindow, e);
+			}
+			if (hit.isHoldEnd) {
+				double minTime = holdBeginHitTime[hit.noteIndex] + LiveModel::FRAME_TIME;
+				double minE = minTime - judgeTime;
+				if (e < minE) {
+					e = minE;
+				}
+			}
+			hit.time = judgeTime + e;
+			double perfectWindow = hit.isSlide ? model.slidePerfectWindow : model.hitPerfectWindow;
+			hit.isPerfect = (fabs(e) < perfectWindow);
+			if (hit.isHoldBegin) {
+				holdBeginPerfect[hit.noteIndex] = hit.isPerfect;
+				holdBeginHitTime[hit.noteIndex] = hit.time;
+			}
+		}
+#if USE_INSERTION_SORT
+		insertionSort(hits.begin(), hits.end(), compareTime);
+#else
+		sort(hits.begin(), hits.end(), compareTime);
+#endif
+		auto & perfectMask = judgments.perfectMasks[k];
+		auto & starPerfectMask = judgments.starPerfectMasks[k];
+		fill(perfectMask.begin(), perfectMask.end(), 0);
+		fill(starPerfectMask.begin(), starPerfectMask.end(), 0);
+		for (size_t i = 0; i < hits.size(); i++) {
+			const auto & hit = hits[i];
+			int bit = static_cast<int>(i);
+			if (hit.isHoldBegin) {
+				continue;
+			}
+			if (hit.isHoldEnd) {
+				judgments.holdEndHits[k][hit.noteIndex] = bit;
+			}
+			if (hit.isPerfect && (!hit.isHoldEnd || holdBeginPerfect[hit.noteIndex])) {
+				setBit(perfectMask, bit);
+				if (notes[hit.noteIndex].isBomb) {
+					setBit(starPerfectMask, bit);
+				}
+			}
+		}
+	}
+#else
+#if defined(__AVX__)
+	// Every gap takes a libm log, which is several times slower while the
+	// upper halves of the vector registers are dirty
+	_mm256_zeroupper();
+#endif
+	// Complemented uniforms give antithetic gaps
+	rng.seed(seed, id, complement);
+	for (size_t k = 0; k < model.charts.size(); k++) {
+		fill(judgments.hitPerfects[k].begin(), judgments.hitPerfects[k].end(), ~UINT64_C(0));
+		fill(judgments.holdBeginPerfects[k].begin(), judgments.holdBeginPerfects[k].end(), true);
+		copy(model.chartPerfectMasks[k].begin(), model.chartPerfectMasks[k].end(), judgments.perfectMasks[k].begin());
+		copy(model.chartStarMasks[k].begin(), model.chartStarMasks[k].end(), judgments.starPerfectMasks[k].begin());
+	}
+	// Skip from great to great, O(greats) draws instead of one per hit
+	for (int c = 0; c < LiveModel::HIT_CLASS_NUM; c++) {
+		const auto & classHits = model.classHits[c];
+		auto & gaps = greatGaps[c];
+		int greats = 0;
+		if (gaps.p() > 0) {
+			bool always = !(gaps.p() < 1);
+			for (uint64_t i = always ? 0 : gaps(rng); i < classHits.size(); i += always ? 1 : gaps(rng) + 1) {
+				const auto & ref = classHits[i];
+				greats++;
+				resetBit(judgments.hitPerfects[ref.chart], ref.hit);
+				resetBit(judgments.perfectMasks[ref.chart], ref.hit);
+				resetBit(judgments.starPerfectMasks[ref.chart], ref.hit);
+				if (ref.holdBeginNote >= 0) {
+					int holdEnd = model.holdEndHits[ref.chart][ref.holdBeginNote];
+					judgments.holdBeginPerfects[ref.chart][ref.holdBeginNote] = false;
+					resetBit(judgments.perfectMasks[ref.chart], holdEnd);
+					resetBit(judgments.starPerfectMasks[ref.chart], holdEnd);
+				}
+			}
+		}
+		judgments.classGreats[c] = greats;
+	}
+	judgments.logWeight = 0;
+	if (tilted) {
+		for (int c = 0; c < LiveModel::HIT_CLASS_NUM; c++) {
+			int greats = judgments.classGreats[c];
+			int perfects = static_cast<int>(model.classHits[c].size()) - greats;
+			judgments.logWeight += perfects * greatLogWeights[c][0] + greats * greatLogWeights[c][1];
+		}
+	}
+#endif
+}
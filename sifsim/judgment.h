@@ -0,0 +1,77 @@
+#pragma once
+#include "configure.h"
+
+#include <vector>
+#include <array>
+#include <cstdint>
+#include "livemodel.h"
+#include "bulkrandom.h"
+
+
+// Outcome of every hit in one iteration. It only depends on the charts and the
+// accuracy settings, so lives with the same ones can share it.
+struct HitJudgments {
+	explicit HitJudgments(const LiveModel & model);
+
+#if SIMULATE_HIT_TIMING
+	// Hits sorted by judged time
+	std::vector<std::vector<LiveModel::Hit>> chartHits;
+	// Sorted hit index of the hold end of each note, -1 if not a hold
+	std::vector<std::vector<int>> holdEndHits;
+#else
+	std::vector<std::vector<uint64_t>> hitPerfects;
+	// Number of greats of each hit class
+	std::array<int, LiveModel::HIT_CLASS_NUM> classGreats = {};
+#endif
+	std::vector<std::vector<unsigned char>> holdBeginPerfects;
+	// Hits counted by perfect/starPerfect if no judge skill is active, one bit per hit
+	std::vector<std::vector<uint64_t>> perfectMasks;
+	std::vector<std::vector<uint64_t>> starPerfectMasks;
+	// Log likelihood ratio of the judgments, untilted over tilted, see HitJudge::setTilt
+	double logWeight = 0;
+};
+
+
+// Draws the hit judgments of iteration id from BulkRandom(seed, id)
+class HitJudge {
+public:
+	explicit HitJudge(const LiveModel & model);
+	void judge(uint64_t id, uint64_t seed, HitJudgments & judgments);
+
+	// Odd ids take the antithetic judgments of id - 1
+	void setAntithetic(bool value) {
+		antithetic = value;
+	}
+
+	// Importance sampling: the odds of a great are multiplied by e^-tilt,
+	// so there are fewer greats for tilt > 0. Ignored with hit timing.
+	void setTilt(double tilt);
+
+	// Whether two models give the same judgments for the same (seed, id)
+	static bool isShareable(const LiveModel & a, const LiveModel & b);
+
+#if !SIMULATE_HIT_TIMING
+	// Replaces the judgments of hit `hit` of chart `chart` and later ones in
+	// `into` with those in `from`. Every hit is judged independently, so this
+	// gives the judgments of a live that continues with fresh randomness.
+	void splice(const HitJudgments & from, size_t chart, int hit, HitJudgments & into) const;
+#endif
+
+private:
+	const LiveModel & model;
+	bool antithetic = false;
+	BulkRandom rng;
+#if SIMULATE_HIT_TIMING
+	NormalDistribution<> eHit;
+	NormalDistribution<> eHoldBegin;
+	NormalDistribution<> eHoldEnd;
+	NormalDistribution<> eSlide;
+	std::vector<std::vector<double>> holdBeginHitTimes;
+#else
+	std::array<GeometricDistribution<>, LiveModel::HIT_CLASS_NUM> greatGaps;
+	// Log likelihood ratios of a perfect and a great per class
+	std::array<std::array<double, 2>, LiveModel::HIT_CLASS_NUM> greatLogWeights = {};
+	// Whether any log weight isn't 0
+	bool tilted = false;
+#endif
+};
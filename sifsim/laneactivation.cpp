@@ -0,0 +1,120 @@
+#include "laneactivation.h"
+#include "counterrandom.h"
+#include <algorithm>
+#if USE_SIMD_RANDOM && defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+
+void LaneActivations::seed(uint64_t seed, uint32_t card, const Ids & ids, unsigned complements) {
+	seedValue = seed;
+	this->card = card;
+	this->ids = ids;
+	this->complements = complements;
+}
+
+
+int LaneActivations::countLane(size_t j, int percent, int events) const {
+	CounterRandom rng;
+	rng.seed(seedValue, ids[j], CounterRandom::Purpose::Activation, card, (complements >> j) & 1);
+	int successes = 0;
+	for (int i = 0; i < events; i++) {
+		successes += static_cast<int>(rng(100)) < percent;
+	}
+	return successes;
+}
+
+
+#if USE_SIMD_RANDOM && defined(__AVX2__)
+// Low and high halves of the 32x32-bit products of every lane
+static void MulLoHi(__m256i a, __m256i m, __m256i & lo, __m256i & hi) {
+	__m256i even = _mm256_mul_epu32(a, m);
+	__m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+	lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xaa);
+	hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xaa);
+}
+#endif
+
+
+// Every stream draws from block 0 on, so a lane's roll i is word i % 4 of
+// block i / 4 unless an earlier draw was rejected, which happens with odds
+// 96 / 2^32 per draw and sends the lane to countLane
+LaneActivations::Counts LaneActivations::count(int percent, const Counts & events) const {
+	Counts successes = {};
+	int maxEvents = *max_element(events.begin(), events.end());
+	if (!maxEvents) {
+		return successes;
+	}
+#if USE_SIMD_RANDOM && defined(__AVX2__)
+	static_assert(LANES == 8, "The AVX2 kernel rolls 8 lanes");
+	alignas(32) array<uint32_t, LANES> idLo, idHi, complementMask;
+	for (size_t j = 0; j < LANES; j++) {
+		idLo[j] = static_cast<uint32_t>(ids[j]);
+		idHi[j] = static_cast<uint32_t>(ids[j] >> 32);
+		complementMask[j] = (complements >> j) & 1 ? UINT32_MAX : 0;
+	}
+	const __m256i vIdLo = _mm256_load_si256(reinterpret_cast<const __m256i *>(idLo.data()));
+	const __m256i vIdHi = _mm256_load_si256(reinterpret_cast<const __m256i *>(idHi.data()));
+	const __m256i vComplement = _mm256_load_si256(reinterpret_cast<const __m256i *>(complementMask.data()));
+	const __m256i vEvents = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(events.data()));
+	const __m256i vSub = _mm256_set1_epi32(static_cast<int>(
+		static_cast<uint32_t>(CounterRandom::Purpose::Activation) << 24 | card));
+	const __m256i m0 = _mm256_set1_epi64x(CounterRandom::M0);
+	const __m256i m1 = _mm256_set1_epi64x(CounterRandom::M1);
+	// r % 100 as r - (r * 0x51eb851f >> 37) * 100, exact for 32-bit r
+	const __m256i div100 = _mm256_set1_epi64x(UINT32_C(0x51eb851f));
+	const __m256i v100 = _mm256_set1_epi32(100);
+	const __m256i v99 = _mm256_set1_epi32(99);
+	// CounterRandom rejects draws below (2^32 - 100) % 100 = 96
+	const __m256i v95 = _mm256_set1_epi32(95);
+	const __m256i vPercent = _mm256_set1_epi32(percent);
+	__m256i vSuccesses = _mm256_setzero_si256();
+	__m256i vRejected = _mm256_setzero_si256();
+	for (int block = 0; block * 4 < maxEvents; block++) {
+		__m256i c0 = _mm256_set1_epi32(block), c1 = vSub, c2 = vIdLo, c3 = vIdHi;
+		uint32_t k0 = static_cast<uint32_t>(seedValue), k1 = static_cast<uint32_t>(seedValue >> 32);
+		for (int round = 0; round < 10; round++) {
+			if (round > 0) {
+				k0 += CounterRandom::W0;
+				k1 += CounterRandom::W1;
+			}
+			__m256i lo0, hi0, lo1, hi1;
+			MulLoHi(c0, m0, lo0, hi0);
+			MulLoHi(c2, m1, lo1, hi1);
+			c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), _mm256_set1_epi32(static_cast<int>(k0)));
+			c1 = lo1;
+			c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), _mm256_set1_epi32(static_cast<int>(k1)));
+			c3 = lo0;
+		}
+		const __m256i words[4] = { c0, c1, c2, c3 };
+		for (int w = 0; w < 4 && block * 4 + w < maxEvents; w++) {
+			__m256i r = words[w];
+			__m256i active = _mm256_cmpgt_epi32(vEvents, _mm256_set1_epi32(block * 4 + w));
+			// Unsigned r <= 95
+			__m256i rejected = _mm256_cmpeq_epi32(_mm256_min_epu32(r, v95), r);
+			vRejected = _mm256_or_si256(vRejected, _mm256_and_si256(rejected, active));
+			__m256i lo, q;
+			MulLoHi(r, div100, lo, q);
+			q = _mm256_srli_epi32(q, 5);
+			__m256i roll = _mm256_sub_epi32(r, _mm256_mullo_epi32(q, v100));
+			roll = _mm256_blendv_epi8(roll, _mm256_sub_epi32(v99, roll), vComplement);
+			__m256i success = _mm256_and_si256(_mm256_cmpgt_epi32(vPercent, roll), active);
+			vSuccesses = _mm256_sub_epi32(vSuccesses, success);
+		}
+	}
+	_mm256_storeu_si256(reinterpret_cast<__m256i *>(successes.data()), vSuccesses);
+	unsigned rejectedLanes = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(vRejected)));
+	for (size_t j = 0; j < LANES; j++) {
+		if ((rejectedLanes >> j) & 1) {
+			successes[j] = countLane(j, percent, events[j]);
+		}
+	}
+#else
+	for (size_t j = 0; j < LANES; j++) {
+		successes[j] = countLane(j, percent, events[j]);
+	}
+#endif
+	return successes;
+}
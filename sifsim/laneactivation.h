@@ -0,0 +1,35 @@
+#pragma once
+#include "configure.h"
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+
+// Activation rolls of one card for LANES lives at once. Lane j rolls from the
+// card's Philox stream of (seed, ids[j]) like ActivationRandom without QMC or
+// tilt, so each lane gets the same outcomes as rolling it alone; lanes with
+// fewer events are masked out of the later rolls.
+class LaneActivations {
+public:
+	static constexpr size_t LANES = 8;
+
+	typedef std::array<uint64_t, LANES> Ids;
+	typedef std::array<int, LANES> Counts;
+
+	// complements: bit j set if lane j draws complemented (antithetic) numbers
+	void seed(uint64_t seed, uint32_t card, const Ids & ids, unsigned complements);
+
+	// Successes of the first events[j] rolls (*this)(100) < percent of lane j,
+	// percent being ActivationPercent of the threshold
+	Counts count(int percent, const Counts & events) const;
+
+private:
+	// Lane j one by one, also used for the rare draws rejected by the bounded roll
+	int countLane(size_t j, int percent, int events) const;
+
+	uint64_t seedValue = 0;
+	uint32_t card = 0;
+	Ids ids = {};
+	unsigned complements = 0;
+};
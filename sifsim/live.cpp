@@ -1,8 +1,6 @@
 #include "configure.h"
 #include "live.h"
 #include "util.h"
-#include "rapidjson/document.h"
-#include "rapidjsonutil.h"
 #include <cmath>
 #include <queue>
 #include <stdexcept>
@@ -15,441 +13,100 @@ using namespace std;
 using namespace std::literals;
 
 
-const auto compareTime = [](const auto & a, const auto & b) {
-	return a.time < b.time;
-};
-
-
-Live::Live(FILE * fp) {
-	rapidjson::Document doc = ParseJsonFile(fp);
-	if (!doc.IsObject()) {
-		throw JsonParseError("Invalid input");
-	}
-	loadSettings(GetJsonMember(doc, "settings"));
-	auto itLiveBonus = doc.FindMember("live_bonus");
-	if (itLiveBonus != doc.MemberEnd() && !itLiveBonus->value.IsNull()) {
-		loadLiveBonus(itLiveBonus->value);
-	}
-	auto itSkillOrder = doc.FindMember("skill_trigger_priority");
-	if (itSkillOrder != doc.MemberEnd() && !itSkillOrder->value.IsNull()) {
-		loadSkillOrder(itSkillOrder->value);
-	}
-	loadUnit(GetJsonMember(doc, "cards"));
-	loadCharts(GetJsonMember(doc, "lives"));
-	processUnit();
-	processCharts();
-}
-
-
-void Live::loadSettings(const rapidjson::Value & json) {
-	if (!json.IsObject()) {
-		throw JsonParseError("Invalid input: settings");
-	}
-	mode = static_cast<LiveMode>(GetJsonMemberInt(json, "mode"));
-	hiSpeed = GetJsonMemberDouble(json, "note_speed");
-	judgeOffset = TryGetJsonMemberDouble(json, "judge_offset").value_or(0);
-#if SIMULATE_HIT_TIMING
-	loadHitError(GetJsonMember(json, "hit_error"));
-#else
-	auto itJudgeWindow = json.FindMember("judge_window");
-	if (itJudgeWindow != json.MemberEnd() && !itJudgeWindow->value.IsNull()) {
-		auto & jsonJudgeWindow = itJudgeWindow->value;
-		if (!jsonJudgeWindow.IsArray() || jsonJudgeWindow.Size() < 3) {
-			throw JsonParseError("Invalid input: settings.judge_window");
-		}
-		hitPerfectWindow = GetJsonItemDouble(jsonJudgeWindow, 0);
-		hitGreatWindow = GetJsonItemDouble(jsonJudgeWindow, 1);
-		slidePerfectWindow = hitGreatWindow;
-		slideGreatWindow = GetJsonItemDouble(jsonJudgeWindow, 2);
-	} else {
-		constexpr double JUDGE_MIN_SPEED = 0.8;
-		constexpr double PLAYAREA_R = 400;
-		constexpr double PERFECT_WINDOW_TICKS = 16;
-		constexpr double GREAT_WINDOW_TICKS = 40;
-		constexpr double GOOD_WINDOW_TICKS = 64;
-		double judgeTick = fmax(hiSpeed, JUDGE_MIN_SPEED) / PLAYAREA_R;
-		hitPerfectWindow = judgeTick * PERFECT_WINDOW_TICKS;
-		hitGreatWindow = judgeTick * GREAT_WINDOW_TICKS;
-		slidePerfectWindow = hitGreatWindow;
-		slideGreatWindow = judgeTick * GOOD_WINDOW_TICKS;
-	}
-	auto itHitError = json.FindMember("hit_error");
-	if (itHitError != json.MemberEnd() && !itHitError->value.IsNull()) {
-		loadHitError(itHitError->value);
-	} else {
-		loadGreatRate(GetJsonMember(json, "hit_great_rate"));
-	}
-#endif
-}
-
-
-#if SIMULATE_HIT_TIMING
-
-void Live::loadHitError(const rapidjson::Value & json) {
-	if (!json.IsObject()) {
-		throw JsonParseError("Invalid input: settings.hit_error");
-	}
-	const auto readParam = [](const rapidjson::Value & obj) {
-		double mean = TryGetJsonMemberDouble(obj, "mean").value_or(0);
-		double stddev = GetJsonMemberDouble(obj, "stddev");
-		return NormalDistribution<>::param_type(mean, stddev);
-	};
-	eHit.param(readParam(GetJsonMemberObject(json, "hit")));
-	eHoldBegin.param(readParam(GetJsonMemberObject(json, "hold_begin")));
-	eHoldEnd.param(readParam(GetJsonMemberObject(json, "hold_end")));
-	eSlide.param(readParam(GetJsonMemberObject(json, "slide")));
-}
-
-#else
-
-void Live::loadHitError(const rapidjson::Value & json) {
-	if (!json.IsObject()) {
-		throw JsonParseError("Invalid input: settings.hit_error");
-	}
-	const auto readParam = [](const rapidjson::Value & obj, double window) {
-		constexpr double SQRT1_2 = 0.707106781186547524401;
-		double mean = TryGetJsonMemberDouble(obj, "mean").value_or(0);
-		double stddev = GetJsonMemberDouble(obj, "stddev");
-		double gRate = 0.5 * (erfc((window - mean) / stddev * SQRT1_2)
-			+ erfc((window + mean) / stddev * SQRT1_2));
-		return BernoulliDistribution::param_type(gRate);
-	};
-	gHit.param(readParam(GetJsonMemberObject(json, "hit"), hitPerfectWindow));
-	gHoldBegin.param(readParam(GetJsonMemberObject(json, "hold_begin"), hitPerfectWindow));
-	gHoldEnd.param(readParam(GetJsonMemberObject(json, "hold_end"), hitPerfectWindow));
-	gSlide.param(readParam(GetJsonMemberObject(json, "slide"), slidePerfectWindow));
-	gSlideHoldEnd.param(readParam(GetJsonMemberObject(json, "hold_end"), slidePerfectWindow));
-}
-
-
-void Live::loadGreatRate(const rapidjson::Value & json) {
-	if (!json.IsObject()) {
-		throw JsonParseError("Invalid input: settings.hit_great_rate");
-	}
-	gHit.param(BernoulliDistribution::param_type(GetJsonMemberDouble(json, "hit")));
-	gHoldBegin.param(BernoulliDistribution::param_type(GetJsonMemberDouble(json, "hold_begin")));
-	gHoldEnd.param(BernoulliDistribution::param_type(GetJsonMemberDouble(json, "hold_end")));
-	gSlide.param(BernoulliDistribution::param_type(GetJsonMemberDouble(json, "slide")));
-	gSlideHoldEnd.param(BernoulliDistribution::param_type(GetJsonMemberDouble(json, "hold_end")));
+Live::Live(const LiveModel & model) : model(model), judge(model), ownJudgments(model) {
+	holdBeginPerfects = ownJudgments.holdBeginPerfects;
+	perfectMasks = ownJudgments.perfectMasks;
+	cards.resize(model.cards.size());
 }
 
-#endif
-
 
-void Live::loadLiveBonus(const rapidjson::Value & json) {
-	if (!json.IsObject()) {
-		throw JsonParseError("Invalid input: live_bonus");
-	}
-	liveScoreRate = TryGetJsonMemberDouble(json, "bonus_score_rate").value_or(1);
-	liveActivationRate = TryGetJsonMemberDouble(json, "bonus_activation_rate").value_or(1);
-	auto itGuestBonus = json.FindMember("guest_bonus");
-	if (itGuestBonus != json.MemberEnd() && !itGuestBonus->value.IsNull()) {
-		// TODO: load MF guest bonus
-		throw runtime_error("MF guest bonus not implemented");
-	}
+LiveResult Live::simulate(uint64_t id, uint64_t seed) {
+	judge.judge(id, seed, ownJudgments);
+	return simulate(id, seed, ownJudgments);
 }
 
 
-void Live::loadSkillOrder(const rapidjson::Value & json) {
-	if (!json.IsArray()) {
-		throw JsonParseError("Invalid input: skill_trigger_priority");
-	}
-	for (const auto & i : json.GetArray()) {
-		if (!i.IsInt()) {
-			throw JsonParseError("Invalid input: skill_trigger_priority");
-		}
-		skillOrder.emplace_back(i.GetInt());
-	}
+LiveResult Live::simulate(uint64_t id, uint64_t seed, const HitJudgments & hitJudgments) {
+	start(id, seed, hitJudgments);
+	run();
+	return result();
 }
 
 
-void Live::loadUnit(const rapidjson::Value & json) {
-	if (!json.IsArray()) {
-		throw JsonParseError("Invalid input: cards");
-	}
-	unitStatus = 0;
-	judgeSisStatus = 0;
-	cards.reserve(json.Size());
-	for (const auto & jsonCard : json.GetArray()) {
-		if (!jsonCard.IsObject()) {
-			throw JsonParseError("Invalid input: cards");
-		}
-		cards.emplace_back();
-		auto & card = cards.back();
-		card.type = GetJsonMemberInt(jsonCard, "unit_type");
-		card.category = GetJsonMemberInt(jsonCard, "member_category");
-		card.attribute = GetJsonMemberInt(jsonCard, "attribute");
-		card.baseStatus = GetJsonMemberInt(jsonCard, "base_status");
-		card.status = GetJsonMemberInt(jsonCard, "status");
-		unitStatus += card.status;
-
-		auto & skill = card.skill;
-		auto itSkill = jsonCard.FindMember("skill");
-		if (itSkill == jsonCard.MemberEnd() || itSkill->value.IsNull()) {
-			skill.effect = Skill::Effect::None;
-		} else {
-			const auto & jsonSkill = itSkill->value;
-			if (!jsonSkill.IsObject()) {
-				throw JsonParseError("Invalid input: cards[].skill");
-			}
-			skill.effect = static_cast<Skill::Effect>(GetJsonMemberInt(jsonSkill, "effect_type"));
-			skill.discharge = static_cast<Skill::Discharge>(GetJsonMemberInt(jsonSkill, "discharge_type"));
-			skill.trigger = static_cast<Skill::Trigger>(GetJsonMemberInt(jsonSkill, "trigger_type"));
-			skill.level = GetJsonMemberInt(jsonSkill, "level");
-			auto itEffectTargets = jsonSkill.FindMember("effect_targets");
-			if (itEffectTargets != jsonSkill.MemberEnd() && !itEffectTargets->value.IsNull()) {
-				const auto & jsonEffectTargets = itEffectTargets->value;
-				if (!jsonEffectTargets.IsArray()) {
-					throw JsonParseError("Invalid input: cards[].skill.effect_targets");
-				}
-				for (const auto & target : jsonEffectTargets.GetArray()) {
-					if (!target.IsInt()) {
-						throw JsonParseError("Invalid input: cards[].skill.effect_targets");
-					}
-					skill.effectTargets.emplace_back(target.GetInt());
-				}
-			}
-			auto itTriggerTargets = jsonSkill.FindMember("trigger_targets");
-			if (itTriggerTargets != jsonSkill.MemberEnd() && !itTriggerTargets->value.IsNull()) {
-				const auto & jsonTriggerTargets = itTriggerTargets->value;
-				if (!jsonTriggerTargets.IsArray()) {
-					throw JsonParseError("Invalid input: cards[].skill.trigger_targets");
-				}
-				for (const auto & target : jsonTriggerTargets.GetArray()) {
-					if (!target.IsInt()) {
-						throw JsonParseError("Invalid input: cards[].skill.trigger_targets");
-					}
-					skill.chainTargets.emplace_back(target.GetInt());
-				}
-			}
-			const auto & jsonLevels = GetJsonMemberArray(jsonSkill, "levels");
-			for (const auto & jsonLevel : jsonLevels.GetArray()) {
-				if (!jsonLevel.IsObject()) {
-					throw JsonParseError("Invalid input: cards[].skill.levels");
-				}
-				skill.levels.emplace_back();
-				auto & level = skill.levels.back();
-				level.effectValue = GetJsonMemberDouble(jsonLevel, "effect_value");
-				level.dischargeTime = GetJsonMemberDouble(jsonLevel, "discharge_time");
-				level.triggerValue = GetJsonMemberInt(jsonLevel, "trigger_value");
-				level.activationRate = GetJsonMemberInt(jsonLevel, "activation_rate");
-			}
-			auto itSisList = jsonCard.FindMember("school_idol_skills");
-			if (itSisList != jsonCard.MemberEnd() && !itSisList->value.IsNull()) {
-				// Translate SIS effect, assume FC
-				const auto & jsonSisList = itSisList->value;
-				if (!jsonSisList.IsObject()) {
-					throw JsonParseError("Invalid input: cards[].skill.school_idol_skills");
-				}
-				auto charm = TryGetJsonMemberDouble(jsonSisList, "charm");
-				if (charm && skill.effect == Skill::Effect::ScorePlus) {
-					for (auto & level : skill.levels) {
-						level.effectValue += Ceil(level.effectValue * *charm / 100.0);
-					}
-				}
-				auto trick = TryGetJsonMemberDouble(jsonSisList, "trick");
-				if (trick) {
-					judgeSisStatus += Ceil(card.baseStatus * *trick / 100.0);
-				}
-				auto heal = TryGetJsonMemberDouble(jsonSisList, "heal");
-				if (heal && skill.effect == Skill::Effect::HpRestore) {
-					skill.effect = Skill::Effect::ScorePlus;
-					for (auto & level : skill.levels) {
-						level.effectValue *= *heal;
-					}
-				}
-			}
-		}
+void Live::start(uint64_t id, uint64_t seed, const HitJudgments & hitJudgments) {
+	judgments = &hitJudgments;
+	// Every purpose and card draws from its own stream of (seed, id),
+	// so a change to one card doesn't shift the draws of the others
+	// Antithetic pairs 2k and 2k + 1 draw from the streams of 2k
+	bool complement = antithetic && (id & 1);
+	if (antithetic) {
+		id &= ~UINT64_C(1);
 	}
+	shuffleRng.seed(seed, id, CounterRandom::Purpose::Shuffle, 0, complement);
+	seedCards(id, seed, complement);
+	initSimulation();
+	copyJudgments();
+	startSkillTrigger();
 }
 
 
-void Live::processUnit() {
-	// Check skill order
-	if (!skillOrder.empty()) {
-		if (skillOrder.size() != cards.size()) {
-			throw runtime_error("Invalid skill trigger order");
-		}
-		vector<unsigned char> check(skillOrder.size(), false);
-		for (auto i : skillOrder) {
-			if (i < 0 || i >= check.size() || exchange(check[i], true)) {
-				throw runtime_error("Invalid skill trigger order");
-			}
-		}
-	}
-
-	unsigned i = 0;
-	for (auto & card : cards) {
-		auto & skill = card.skill;
-		// Skill order
-		if (skillOrder.empty()) {
-			card.skillId = i << SKILL_ORDER_SHIFT | i;
-		} else {
-			card.skillId = static_cast<unsigned>(skillOrder[i]) << SKILL_ORDER_SHIFT | i;
-		}
-		i++;
-		// Init chain status array
-		if (skill.trigger == Skill::Trigger::Chain) {
-			card.chainStatus.resize(skill.chainTargets.size());
-		}
-		// Ignore nop skills (assume FC)
-		switch (skill.effect) {
-		case Skill::Effect::GreatToPerfect:
-		case Skill::Effect::GoodToPerfect:
-		case Skill::Effect::ScorePlus:
-		case Skill::Effect::SkillRateUp:
-		case Skill::Effect::Mimic:
-		case Skill::Effect::PerfectBonusRatio:
-		case Skill::Effect::PerfectBonusFixedValue:
-		case Skill::Effect::SyncStatus:
-		case Skill::Effect::GainStatus:
-			skill.valid = true;
-			break;
-
-		case Skill::Effect::None:
-		case Skill::Effect::HpRestore:
-			skill.valid = false;
-			break;
-
-		case Skill::Effect::GainSkillLevel:
-			throw runtime_error("Skill level boost not implemented");
-
-		case Skill::Effect::ComboBonusRatio:
-		case Skill::Effect::ComboBonusFixedValue:
-			throw runtime_error("Combo fever not implemented");
-
-		default:
-			throw runtime_error("Unknown skill effect type: "
-				+ to_string(static_cast<underlying_type_t<Skill::Effect>>(skill.effect)));
-		}
-
-		for (auto target : skill.effectTargets) {
-			if (target < 0 || target >= cards.size()) {
-				throw JsonParseError("Invalid skill target list");
-			}
-		}
-	}
+void Live::reseed(uint64_t id, uint64_t seed) {
+	seedCards(id, seed, false);
 }
 
 
-void Live::loadCharts(const rapidjson::Value & json) {
-	if (!json.IsArray()) {
-		throw JsonParseError("Invalid input: lives");
-	}
-	charts.reserve(json.Size());
-	int totalNotes = 0;
-	for (const auto & jsonChart : json.GetArray()) {
-		if (!jsonChart.IsObject()) {
-			throw JsonParseError("Invalid input: lives");
-		}
-		auto path = TryGetJsonMemberString(jsonChart, "livejson_path");
-		optional<rapidjson::Document> livejson;
-		if (path) {
-			livejson = ParseJsonFile(CFileWrapper(*path, "rb"));
-			if (!livejson->IsArray()) {
-				throw JsonParseError("Invalid livejson file: "s + *path);
-			}
-		}
-		const auto & jsonNotes = path ? *livejson : GetJsonMemberArray(jsonChart, "livejson");
-		charts.emplace_back();
-		auto & chart = charts.back();
-
-		chart.memberCategory = GetJsonMemberInt(jsonChart, "member_category");
-		int noteNum = jsonNotes.Size();
-		chart.beginNote = totalNotes;
-		totalNotes += noteNum;
-		chart.endNote = totalNotes;
-		chart.notes.reserve(noteNum);
-		for (const auto & noteObj : jsonNotes.GetArray()) {
-			if (!noteObj.IsObject()) {
-				throw JsonParseError("Invalid livejson");
-			}
-			chart.notes.emplace_back();
-			auto & note = chart.notes.back();
-
-			note.position = GetJsonMemberInt(noteObj, "position");
-			note.attribute = GetJsonMemberInt(noteObj, "notes_attribute");
-			note.effect(static_cast<Note::Effect>(GetJsonMemberInt(noteObj, "effect")));
-			double t = GetJsonMemberDouble(noteObj, "timing_sec");
-			// SIF built-in offset :<
-			note.time = t - 0.1;
-			note.showTime = note.time - hiSpeed;
-			if (note.isHold) {
-				note.holdEndTime = note.time + GetJsonMemberDouble(noteObj, "effect_value");
-			} else {
-				note.holdEndTime = NAN;
-			}
-		}
-		if (!is_sorted(chart.notes.begin(), chart.notes.end(), compareTime)) {
-			sort(chart.notes.begin(), chart.notes.end(), compareTime);
-		}
-		chart.lastNoteShowTime = chart.notes.empty() ? 0 : chart.notes.back().showTime;
+void Live::seedCards(uint64_t id, uint64_t seed, bool complement) {
+	for (size_t i = 0; i < cards.size(); i++) {
+		auto sub = static_cast<uint32_t>(i);
+		cards[i].activationRng.seed(seed, id, sub, complement, qmc, activationTilt ? &*activationTilt : nullptr);
+		cards[i].syncRng.seed(seed, id, CounterRandom::Purpose::Sync, sub, complement);
 	}
 }
 
 
-void Live::processCharts() {
-	int cardNum = static_cast<int>(cards.size());
-	chartHits.reserve(charts.size());
-	combos.reserve(accumulate(charts.begin(), charts.end(), size_t{ 0 }, [](size_t x, const auto & c) {
-		return x + c.notes.size();
-	}));
-	for (auto & chart : charts) {
-		chartHits.emplace_back();
-		auto & hits = chartHits.back();
-
-		// In livejson, leftmost = 9, rightmost = 1
-		// Transform to leftmost = 0, rightmost = 8
-		for (auto & note : chart.notes) {
-			if (note.position <= 0 || note.position > cardNum) {
-				throw runtime_error("Invalid note position: " + to_string(note.position));
-			}
-			note.position = cardNum - note.position;
-		}
-
-		for (size_t i = 0; i < chart.notes.size(); i++) {
-			const auto & note = chart.notes[i];
-			hits.emplace_back(static_cast<int>(i), note, false);
-			if (note.isHold) {
-				hits.emplace_back(static_cast<int>(i), note, true);
-			}
-		}
-		sort(hits.begin(), hits.end(), compareTime);
-
-		for (const auto & h : hits) {
-			if (!h.isHoldBegin) {
-				combos.emplace_back(h.time);
-			}
-		}
-		assert(combos.size() == chart.endNote);
-	}
-}
-
-
-int Live::simulate(uint64_t id, uint64_t seed) {
-	constexpr uint64_t RNG_ADVANCE = UINT64_C(7640891576956012744);
-	rng.seed(seed);
-	rng.advance(id * RNG_ADVANCE);
-	initSimulation();
-	simulateHitError();
-	startSkillTrigger();
-	for (chartIndex = 0; chartIndex < charts.size(); chartIndex++) {
-		if (chartIndex > 0) {
-			initNextSong();
+bool Live::run(size_t stopChart, int stopHit) {
+	while (chartIndex < model.charts.size()) {
+		const auto & chart = model.charts[chartIndex];
+#if SIMULATE_HIT_TIMING
+		const auto & hits = judgments->chartHits[chartIndex];
+		const auto & holdEnds = judgments->holdEndHits[chartIndex];
+		const auto isRawPerfect = [&](int i) { return hits[i].isPerfect; };
+#else
+		const auto & hits = model.chartHits[chartIndex];
+		const auto & holdEnds = model.holdEndHits[chartIndex];
+		const auto & perfects = judgments->hitPerfects[chartIndex];
+		const auto isRawPerfect = [&](int i) { return testBit(perfects, i); };
+#endif
+		auto & holdBeginPerfect = holdBeginPerfects[chartIndex];
+		const auto & noteMuls = model.chartNoteMuls[chartIndex];
+		updatePerfectTriggerHits();
+		int hitLimit = static_cast<int>(hits.size());
+		if (chartIndex == stopChart) {
+			hitLimit = min(hitLimit, stopHit);
 		}
-		auto & chart = charts[chartIndex];
-		auto & hits = chartHits[chartIndex];
 		for (;;) {
 			if (hitIndex < hits.size()
 				&& (skillEvents.empty() || !(skillEvents.top().time < hits[hitIndex].time))
 				) {
+				if (hitIndex >= hitLimit) {
+					// Stopped with the events before the hit done
+					return false;
+				}
+				if (threshold && thresholdDecided()) {
+					return true;
+				}
 				// Note hit/release
 				const auto & hit = hits[hitIndex];
 				time = hit.time;
-				bool isPerfect = hit.isPerfect || judgeCount;
-				auto & note = chart.notes[hit.noteIndex];
+				bool isPerfect = isRawPerfect(hitIndex) || judgeCount;
+				const auto & note = chart.notes[hit.noteIndex];
 				if (hit.isHoldBegin) {
-					note.isHoldBeginPerfect = isPerfect;
+					holdBeginPerfect[hit.noteIndex] = isPerfect;
+					int end = holdEnds[hit.noteIndex];
+					if (isPerfect && isRawPerfect(end)) {
+						// Judge skill saved the hold begin, the end counts even if the skill ends before it
+						setBit(perfectMasks[chartIndex], end);
+					}
 					++hitIndex;
 					continue;
 				}
@@ -458,25 +115,23 @@ int Live::simulate(uint64_t id, uint64_t seed) {
 				if (combo > itComboMul->first) {
 					++itComboMul;
 				}
-				if (isPerfect && (!hit.isHoldEnd || note.isHoldBeginPerfect)) {
-					++perfect;
-					for (; !perfectTriggers.empty() && perfect >= perfectTriggers.top().value;
-						perfectTriggers.pop()
-						) {
-						skillEvents.emplace(time, perfectTriggers.top().id);
-					}
-					if (note.isBomb) {
-						++starPerfect;
-						for (; !starPerfectTriggers.empty()
-							&& starPerfect >= starPerfectTriggers.top().value;
-							starPerfectTriggers.pop()
-							) {
-							skillEvents.emplace(time, starPerfectTriggers.top().id);
+				if (judgeCount) {
+					// Judge skills change the outcomes, count note by note
+					if (isPerfect && (!hit.isHoldEnd || holdBeginPerfect[hit.noteIndex])) {
+						++perfect;
+						if (note.isBomb) {
+							++starPerfect;
 						}
 					}
+					countedHit = hitIndex + 1;
+					firePerfectTriggers();
+				} else if (hitIndex == perfectTriggerHit || hitIndex == starPerfectTriggerHit) {
+					countPerfects(hitIndex + 1);
+					firePerfectTriggers();
+					updatePerfectTriggerHits();
 				}
 				// Score
-				score += computeScore(note, isPerfect);
+				score += computeScore(noteMuls[hit.noteIndex], isPerfect, holdBeginPerfect[hit.noteIndex]);
 				for (; !scoreTriggers.empty() && score >= scoreTriggers.top().value;
 					scoreTriggers.pop()
 					) {
@@ -509,32 +164,118 @@ int Live::simulate(uint64_t id, uint64_t seed) {
 				break;
 			}
 		}
+		countPerfects(static_cast<int>(hits.size()));
+		if (++chartIndex < model.charts.size()) {
+			initNextSong();
+		}
 	}
 	clear(scoreTriggers);
 	clear(perfectTriggers);
 	clear(starPerfectTriggers);
-	return static_cast<int>(score);
+	return true;
+}
+
+
+void Live::setThreshold(int threshold) {
+	this->threshold = threshold;
+	if (threshold && !scoreBound) {
+		scoreBound.emplace(model);
+	}
+}
+
+
+// Scores only go up
+bool Live::thresholdDecided() const {
+	return score >= threshold || score + (*scoreBound)(chartIndex, hitIndex, time) < threshold;
+}
+
+
+LiveResult Live::result() const {
+	LiveResult result{ static_cast<int>(score), covariates, judgments->logWeight };
+#if !SIMULATE_HIT_TIMING
+	copy(judgments->classGreats.begin(), judgments->classGreats.end(), result.covariates.begin() + LiveResult::GREATS_FIRST);
+#endif
+	for (const auto & card : cards) {
+		result.logWeight += card.activationRng.logWeight();
+	}
+	return result;
 }
 
 
+#if SIMULATE_HIT_TIMING
+void Live::rejudge(const HitJudgments & hitJudgments) {
+	judgments = &hitJudgments;
+}
+#else
+void Live::rejudge(const HitJudgments & hitJudgments) {
+	judgments = &hitJudgments;
+	for (size_t k = chartIndex; k < model.charts.size(); k++) {
+		if (k != chartIndex) {
+			holdBeginPerfects[k] = judgments->holdBeginPerfects[k];
+			perfectMasks[k] = judgments->perfectMasks[k];
+			continue;
+		}
+		const auto & hits = model.chartHits[k];
+		auto & holdBeginPerfect = holdBeginPerfects[k];
+		auto & perfectMask = perfectMasks[k];
+		for (int i = hitIndex; i < static_cast<int>(hits.size()); i++) {
+			if (hits[i].isHoldBegin) {
+				holdBeginPerfect[hits[i].noteIndex] = judgments->holdBeginPerfects[k][hits[i].noteIndex];
+			}
+			if (testBit(judgments->perfectMasks[k], i)) {
+				setBit(perfectMask, i);
+			} else {
+				resetBit(perfectMask, i);
+			}
+		}
+		// Holds begun already keep how their begins were counted, judge skills included
+		for (int i = 0; i < hitIndex; i++) {
+			if (!hits[i].isHoldBegin) {
+				continue;
+			}
+			int end = model.holdEndHits[k][hits[i].noteIndex];
+			if (end < hitIndex) {
+				continue;
+			}
+			if (holdBeginPerfect[hits[i].noteIndex] && testBit(judgments->hitPerfects[k], end)) {
+				setBit(perfectMask, end);
+			} else {
+				resetBit(perfectMask, end);
+			}
+		}
+	}
+}
+#endif
+
+
 void Live::initSimulation() {
 	chartIndex = 0;
 	score = 0;
 	combo = 0;
 	perfect = 0;
 	starPerfect = 0;
-	itComboMul = COMBO_MUL.cbegin();
+	covariates.fill(0);
+	itComboMul = LiveModel::COMBO_MUL.cbegin();
 	for (auto & card : cards) {
 		card.buffedStatus = nullopt;
 		card.syncStatus = nullopt;
 	}
+	// A live stopped partway by run() leaves events and skill effects behind
+	clear(skillEvents);
+	clear(scoreTriggers);
+	clear(perfectTriggers);
+	clear(starPerfectTriggers);
+	judgeCount = 0;
+	activationMod = chartActivationRate;
+	perfectBonusFixedQueue.clear();
+	perfectBonusFixed = 0;
+	perfectBonusRateQueue.clear();
+	perfectBonusRate = 1;
 	initForEverySong();
-	assert(skillEvents.empty());
-	assert(scoreTriggers.empty());
-	assert(perfectTriggers.empty());
-	assert(starPerfectTriggers.empty());
+	// Start from the same order every time so that results depend on id only
+	initSkillOrder();
 	initSkills();
-	if (skillOrder.empty()) {
+	if (model.skillOrder.empty()) {
 		shuffleSkills();
 	}
 }
@@ -549,35 +290,52 @@ void Live::initNextSong() {
 void Live::initForEverySong() {
 	assert(activationMod == chartActivationRate);
 	assert(!judgeCount);
-	const auto & chart = charts[chartIndex];
-	status = unitStatus;
+	status = model.unitStatus;
 	time = 0;
 	hitIndex = 0;
-	chartMemberCategory = chart.memberCategory;
-	chartScoreRate = liveScoreRate;
-	chartActivationRate = liveActivationRate;
+	countedHit = 0;
+	chartScoreRate = model.liveScoreRate;
+	chartActivationRate = model.liveActivationRate;
 	activationMod = chartActivationRate;
 }
 
 
+void Live::initSkillOrder() {
+	unsigned i = 0;
+	for (auto & card : cards) {
+		if (model.skillOrder.empty()) {
+			card.skillId = i << SKILL_ORDER_SHIFT | i;
+		} else {
+			card.skillId = static_cast<unsigned>(model.skillOrder[i]) << SKILL_ORDER_SHIFT | i;
+		}
+		i++;
+	}
+}
+
+
 void Live::shuffleSkills() {
 	for (uint32_t i = static_cast<uint32_t>(cards.size()); i > 1; --i) {
-		swapBits(cards[i - 1].skillId, cards[rng(i)].skillId, SkillOrderMask);
+		swapBits(cards[i - 1].skillId, cards[shuffleRng(i)].skillId, SkillOrderMask);
 	}
 }
 
 
 void Live::initSkills() {
 	for (auto & card : cards) {
-		const auto & skill = card.skill;
+		const auto & skill = cardData(card).skill;
 		if (!skill.valid) {
 			continue;
 		}
 		card.currentSkillLevel = skill.level;
 		card.isActive = false;
 		card.nextTrigger = 0;
-		card.remainingChainTypeNum = static_cast<int>(card.chainStatus.size());
-		fill(card.chainStatus.begin(), card.chainStatus.end(), 1);
+		if (skill.trigger == Skill::Trigger::Chain) {
+			card.remainingChainTypeNum = static_cast<int>(skill.chainTargets.size());
+			card.chainStatus = ~0u;
+		} else {
+			card.remainingChainTypeNum = 0;
+			card.chainStatus = 0;
+		}
 	}
 	initSkillsForEverySong();
 }
@@ -585,7 +343,7 @@ void Live::initSkills() {
 
 void Live::initSkillsForNextSong() {
 	for (auto & card : cards) {
-		const auto & skill = card.skill;
+		const auto & skill = cardData(card).skill;
 		if (!skill.valid) {
 			continue;
 		}
@@ -611,8 +369,8 @@ void Live::initSkillsForNextSong() {
 		case Skill::Trigger::Chain:
 			// Not cleared between songs?
 			/*
-			card.remainingChainTypeNum = skill.chainTypeNum;
-			fill(card.chainStatus.begin(), card.chainStatus.end(), 1);
+			card.remainingChainTypeNum = static_cast<int>(skill.chainTargets.size());
+			card.chainStatus = ~0u;
 			//*/
 			break;
 		}
@@ -623,7 +381,7 @@ void Live::initSkillsForNextSong() {
 
 void Live::initSkillsForEverySong() {
 	for (auto & card : cards) {
-		const auto & skill = card.skill;
+		const auto & skill = cardData(card).skill;
 		if (!skill.valid) {
 			continue;
 		}
@@ -639,83 +397,60 @@ void Live::initSkillsForEverySong() {
 }
 
 
-void Live::simulateHitError() {
-#if SIMULATE_HIT_TIMING
-	for (size_t k = 0; k < charts.size(); k++) {
-		auto & notes = charts[k].notes;
-		auto & hits = chartHits[k];
-		for (auto & hit : hits) {
-			auto & note = notes[hit.noteIndex];
-			double noteTime = hit.isHoldEnd ? note.holdEndTime : note.time;
-			double judgeTime = noteTime + judgeOffset;
-			double e;
-			if (hit.isHoldEnd) {
-				e = eHoldEnd(rng);
-			} else if (hit.isSlide) {
-				e = eSlide(rng);
-			} else if (hit.isHoldBegin) {
-				e = eHoldBegin(rng);
-			} else {
-				e = eHit(rng);
-			}
-			double greatWindow = hit.isSlide ? slideGreatWindow : hitGreatWindow;
-			if (!(fabs(e) < greatWindow)) {
-				e = copysign(greatWindow, e);
-			}
-			if (hit.isHoldEnd) {
-				double minTime = note.holdBeginHitTime + FRAME_TIME;
-				double minE = minTime - judgeTime;
-				if (e < minE) {
-					e = minE;
-				}
-			}
-			hit.time = judgeTime + e;
-			double perfectWindow = hit.isSlide ? slidePerfectWindow : hitPerfectWindow;
-			hit.isPerfect = (fabs(e) < perfectWindow);
-			if (hit.isHoldBegin) {
-				note.isHoldBeginPerfect = hit.isPerfect;
-				note.holdBeginHitTime = hit.time;
-			}
-		}
-#if USE_INSERTION_SORT
-		insertionSort(hits.begin(), hits.end(), compareTime);
-#else
-		sort(hits.begin(), hits.end(), compareTime);
-#endif
+// Judge skills only change whether hold begins and ends count as perfect
+void Live::copyJudgments() {
+	for (size_t k = 0; k < model.charts.size(); k++) {
+		copy(judgments->holdBeginPerfects[k].begin(), judgments->holdBeginPerfects[k].end(), holdBeginPerfects[k].begin());
+		copy(judgments->perfectMasks[k].begin(), judgments->perfectMasks[k].end(), perfectMasks[k].begin());
 	}
-#else
-	for (size_t k = 0; k < charts.size(); k++) {
-		auto & notes = charts[k].notes;
-		auto & hits = chartHits[k];
-		for (auto & hit : hits) {
-			if (hit.isSlide) {
-				if (hit.isHoldEnd) {
-					hit.isPerfect = !gSlideHoldEnd(rng);
-				} else {
-					hit.isPerfect = !gSlide(rng);
-				}
-			} else {
-				if (hit.isHoldBegin) {
-					hit.isPerfect = !gHoldBegin(rng);
-				} else if (hit.isHoldEnd) {
-					hit.isPerfect = !gHoldEnd(rng);
-				} else {
-					hit.isPerfect = !gHit(rng);
-				}
-			}
-			if (hit.isHoldBegin) {
-				auto & note = notes[hit.noteIndex];
-				note.isHoldBeginPerfect = hit.isPerfect;
-			}
-		}
+}
+
+
+void Live::countPerfects(int lastHit) {
+	if (lastHit <= countedHit) {
+		return;
+	}
+	perfect += countBits(perfectMasks[chartIndex], countedHit, lastHit);
+	starPerfect += countBits(judgments->starPerfectMasks[chartIndex], countedHit, lastHit);
+	countedHit = lastHit;
+}
+
+
+void Live::firePerfectTriggers() {
+	for (; !perfectTriggers.empty() && perfect >= perfectTriggers.top().value;
+		perfectTriggers.pop()
+		) {
+		skillEvents.emplace(time, perfectTriggers.top().id);
+	}
+	for (; !starPerfectTriggers.empty() && starPerfect >= starPerfectTriggers.top().value;
+		starPerfectTriggers.pop()
+		) {
+		skillEvents.emplace(time, starPerfectTriggers.top().id);
 	}
-#endif
+}
+
+
+// Finds the hits reaching the next trigger values with popcount/select,
+// so that the main loop needn't check the triggers on every note
+void Live::updatePerfectTriggerHits() {
+	if (judgeCount) {
+		return;
+	}
+	const auto findHit = [&](const auto & queue, const auto & mask, int count) {
+		if (queue.empty()) {
+			return INT_MAX;
+		}
+		int hit = findNthBit(mask, countedHit, queue.top().value - count - 1);
+		return hit < 0 ? INT_MAX : hit;
+	};
+	perfectTriggerHit = findHit(perfectTriggers, perfectMasks[chartIndex], perfect);
+	starPerfectTriggerHit = findHit(starPerfectTriggers, judgments->starPerfectMasks[chartIndex], starPerfect);
 }
 
 
 void Live::startSkillTrigger() {
 	for (auto & card : cards) {
-		const auto & skill = card.skill;
+		const auto & skill = cardData(card).skill;
 		if (!skill.valid) {
 			continue;
 		}
@@ -724,26 +459,14 @@ void Live::startSkillTrigger() {
 }
 
 
-double Live::computeScore(const LiveNote & note, bool isPerfect) const {
-	const auto & card = cards[note.position];
+double Live::computeScore(const LiveModel::NoteMuls & noteMuls, bool isPerfect, bool isHoldBeginPerfect) const {
 	double noteScore = status;
 	noteScore *= isPerfect ? 1.25 : 1.1;
 	// TODO: combo fever
 	noteScore *= itComboMul->second;
 	// Doesn't judge accuracy?
 	noteScore *= perfectBonusRate;
-	if (card.category == chartMemberCategory) {
-		noteScore *= 1.1;
-	}
-	if (note.isHold) {
-		noteScore *= note.isHoldBeginPerfect ? 1.25 : 1.1;
-	}
-	if (note.isSlide) {
-		noteScore *= 0.5;
-	}
-	if (card.attribute == note.attribute) {
-		noteScore *= 1.1;
-	}
+	noteScore = noteMuls.apply(noteScore, isHoldBeginPerfect);
 	noteScore = Floor(noteScore / 100.);
 	// Only judge hold end accuracy?
 	if (isPerfect) {
@@ -757,8 +480,8 @@ double Live::computeScore(const LiveNote & note, bool isPerfect) const {
 }
 
 
-void Live::skillTrigger(LiveCard & card) {
-	auto & skill = card.skill;
+void Live::skillTrigger(CardState & card) {
+	const auto & skill = cardData(card).skill;
 	assert(skill.valid && !card.isActive);
 	bool isMimic = skill.effect == Skill::Effect::Mimic;
 	if (isMimic) {
@@ -767,9 +490,12 @@ void Live::skillTrigger(LiveCard & card) {
 			return;
 		}
 	}
-	const auto & level = card.skillLevel();
+	const auto & level = skillLevel(card);
 	// Effectively ceil(rate * mod)
-	if (rng(100) < level.activationRate * activationMod) {
+	double threshold = level.activationRate * activationMod;
+	bool activated = card.activationRng.activate(threshold);
+	covariates[LiveResult::activationSlot(&card - cards.data())] += activated * 100 - ActivationPercent(threshold);
+	if (activated) {
 		skillOn(card, isMimic);
 	} else {
 		skillSetNextTriggerOnNextFrame(card);
@@ -777,9 +503,10 @@ void Live::skillTrigger(LiveCard & card) {
 }
 
 
-void Live::skillOn(LiveCard & card, bool isMimic) {
-	const auto & skill = isMimic ? cards[card.mimicSkillIndex].skill : card.skill;
-	const auto & level = isMimic ? skill.levels[card.mimicSkillLevel - 1] : card.skillLevel();
+void Live::skillOn(CardState & card, bool isMimic) {
+	const auto & data = cardData(card);
+	const auto & skill = isMimic ? model.cards[card.mimicSkillIndex].skill : data.skill;
+	const auto & level = isMimic ? skill.levels[card.mimicSkillLevel - 1] : skillLevel(card);
 
 	switch (skill.effect) {
 	case Skill::Effect::None:
@@ -789,7 +516,8 @@ void Live::skillOn(LiveCard & card, bool isMimic) {
 	case Skill::Effect::GoodToPerfect:
 		if (!judgeCount) {
 			// Technically not the same as SIF (i.e. floating point addition not associative)
-			status += judgeSisStatus;
+			status += model.judgeSisStatus;
+			countPerfects(hitIndex);
 		}
 		judgeCount++;
 		break;
@@ -835,10 +563,10 @@ void Live::skillOn(LiveCard & card, bool isMimic) {
 		if (skill.effectTargets.empty()) {
 			break;
 		}
-		auto index = rng(static_cast<uint32_t>(skill.effectTargets.size()));
+		auto index = card.syncRng(static_cast<uint32_t>(skill.effectTargets.size()));
 		const auto & target = cards[skill.effectTargets[index]];
-		card.syncStatus = target.getSyncStatus();
-		status += *card.syncStatus - card.status;
+		card.syncStatus = getSyncStatus(target);
+		status += *card.syncStatus - data.status;
 	}
 		break;
 
@@ -849,12 +577,13 @@ void Live::skillOn(LiveCard & card, bool isMimic) {
 	case Skill::Effect::GainStatus:
 		for (const auto & i : skill.effectTargets) {
 			auto & target = cards[i];
+			const auto & targetData = model.cards[i];
 			// Not the same as SIF (return L5_80.buff_rate > 1)
 			if (target.buffedStatus) {
 				continue;
 			}
-			target.buffedStatus = target.status * level.effectValue;
-			status += *target.buffedStatus - target.status;
+			target.buffedStatus = targetData.status * level.effectValue;
+			status += *target.buffedStatus - targetData.status;
 		}
 		break;
 	}
@@ -881,10 +610,11 @@ void Live::skillOn(LiveCard & card, bool isMimic) {
 }
 
 
-void Live::skillOff(LiveCard & card) {
-	assert(card.skill.valid && card.isActive);
-	bool isMimic = card.skill.effect == Skill::Effect::Mimic;
-	const auto & skill = isMimic ? cards[card.mimicSkillIndex].skill : card.skill;
+void Live::skillOff(CardState & card) {
+	const auto & data = cardData(card);
+	assert(data.skill.valid && card.isActive);
+	bool isMimic = data.skill.effect == Skill::Effect::Mimic;
+	const auto & skill = isMimic ? model.cards[card.mimicSkillIndex].skill : data.skill;
 
 	switch (skill.effect) {
 	case Skill::Effect::None:
@@ -896,7 +626,8 @@ void Live::skillOff(LiveCard & card) {
 		--judgeCount;
 		if (!judgeCount) {
 			// Technically not the same as SIF (i.e. floating point addition not associative)
-			status -= judgeSisStatus;
+			status -= model.judgeSisStatus;
+			updatePerfectTriggerHits();
 		}
 		break;
 
@@ -937,7 +668,7 @@ void Live::skillOff(LiveCard & card) {
 		break;
 
 	case Skill::Effect::SyncStatus:
-		status -= *card.syncStatus - card.status;
+		status -= *card.syncStatus - data.status;
 		card.syncStatus = nullopt;
 		break;
 
@@ -948,11 +679,12 @@ void Live::skillOff(LiveCard & card) {
 	case Skill::Effect::GainStatus:
 		for (const auto & i : skill.effectTargets) {
 			auto & target = cards[i];
+			const auto & targetData = model.cards[i];
 			// Not the same as SIF (return L5_80.buff_rate > 1)
 			if (!target.buffedStatus) {
 				continue;
 			}
-			status -= *target.buffedStatus - target.status;
+			status -= *target.buffedStatus - targetData.status;
 			target.buffedStatus = nullopt;
 		}
 
@@ -964,10 +696,10 @@ void Live::skillOff(LiveCard & card) {
 }
 
 
-void Live::skillSetNextTrigger(LiveCard & card) {
+void Live::skillSetNextTrigger(CardState & card) {
 	assert(!card.isActive);
-	const auto & skill = card.skill;
-	const auto & level = card.skillLevel();
+	const auto & skill = cardData(card).skill;
+	const auto & level = skillLevel(card);
 
 	const auto setTransformedTrigger = [&](
 		auto & queue, const auto & curr, bool isCurrTransformed,
@@ -1015,7 +747,7 @@ void Live::skillSetNextTrigger(LiveCard & card) {
 
 	case Skill::Trigger::Time:
 	{
-		const auto & chart = charts[chartIndex];
+		const auto & chart = model.charts[chartIndex];
 		double triggerTime = time + level.triggerValue;
 		if (!(triggerTime < chart.lastNoteShowTime)) {
 			break;
@@ -1026,7 +758,7 @@ void Live::skillSetNextTrigger(LiveCard & card) {
 	}
 	case Skill::Trigger::NotesCount:
 	{
-		const auto & chart = charts[chartIndex];
+		const auto & chart = model.charts[chartIndex];
 		const auto getTime = [&](int note) { return chart.notes[note - chart.beginNote - 1].showTime; };
 		const auto pastEnd = [&](int note) { return note > chart.endNote; };
 		setTransformedTrigger(skillEvents, time, true, getTime, pastEnd);
@@ -1034,8 +766,8 @@ void Live::skillSetNextTrigger(LiveCard & card) {
 	}
 	case Skill::Trigger::ComboCount:
 	{
-		const auto & chart = charts[chartIndex];
-		const auto getTime = [&](int combo) { return combos[combo - 1]; };
+		const auto & chart = model.charts[chartIndex];
+		const auto getTime = [&](int combo) { return model.combos[combo - 1]; };
 		const auto pastEnd = [&](int combo) { return combo > chart.endNote; };
 		setTransformedTrigger(skillEvents, combo, false, getTime, pastEnd);
 		break;
@@ -1045,11 +777,15 @@ void Live::skillSetNextTrigger(LiveCard & card) {
 		break;
 
 	case Skill::Trigger::PerfectCount:
+		countPerfects(hitIndex);
 		setTrigger(perfectTriggers, perfect);
+		updatePerfectTriggerHits();
 		break;
 
 	case Skill::Trigger::StarPerfect:
+		countPerfects(hitIndex);
 		setTrigger(starPerfectTriggers, starPerfect);
+		updatePerfectTriggerHits();
 		break;
 
 	case Skill::Trigger::Chain:
@@ -1061,8 +797,8 @@ void Live::skillSetNextTrigger(LiveCard & card) {
 }
 
 
-void Live::skillSetNextTriggerOnNextFrame(LiveCard & card) {
-	const auto & skill = card.skill;
+void Live::skillSetNextTriggerOnNextFrame(CardState & card) {
+	const auto & skill = cardData(card).skill;
 #if FORCE_SKILL_FRAME_DELAY
 	bool needDelay = (skill.trigger != Skill::Trigger::Time);
 #elif FORCE_SCORE_TRIGGERED_SKILL_FRAME_DELAY
@@ -1072,33 +808,36 @@ void Live::skillSetNextTriggerOnNextFrame(LiveCard & card) {
 #endif
 	if (needDelay) {
 		card.isActive = true;
-		skillEvents.emplace(time + FRAME_TIME, SkillNextTrigger | card.skillId);
+		skillEvents.emplace(time + LiveModel::FRAME_TIME, SkillNextTrigger | card.skillId);
 	} else {
 		skillSetNextTrigger(card);
 	}
 }
 
 
-void Live::updateChain(const LiveCard & otherCard) {
-	const auto & otherSkill = otherCard.skill;
+void Live::updateChain(const CardState & otherCard) {
+	const auto & otherData = cardData(otherCard);
+	const auto & otherSkill = otherData.skill;
 	assert(otherSkill.valid);
 	if (otherSkill.trigger == Skill::Trigger::Chain) {
 		return;
 	}
-	for (const auto & i : chainTriggers) {
+	for (const auto & i : model.chainTriggers) {
 		auto & chainCard = cards[i];
 		if (!chainCard.remainingChainTypeNum) {
 			continue;
 		}
-		const auto & chainSkill = chainCard.skill;
+		const auto & chainSkill = model.cards[i].skill;
 		auto type = find(chainSkill.chainTargets.begin(), chainSkill.chainTargets.end(),
-			otherCard.type);
+			otherData.type);
 		if (type == chainSkill.chainTargets.end()) {
 			continue;
 		}
-		const auto & index = type - chainSkill.chainTargets.begin();
-		chainCard.remainingChainTypeNum -= chainCard.chainStatus[index];
-		chainCard.chainStatus[index] = 0;
+		unsigned bit = 1u << (type - chainSkill.chainTargets.begin());
+		if (chainCard.chainStatus & bit) {
+			--chainCard.remainingChainTypeNum;
+		}
+		chainCard.chainStatus &= ~bit;
 		if (!chainCard.remainingChainTypeNum && !chainCard.isActive) {
 			skillEvents.emplace(time, SkillOn | chainCard.skillId);
 		}
@@ -1106,8 +845,8 @@ void Live::updateChain(const LiveCard & otherCard) {
 }
 
 
-void Live::updateMimic(const LiveCard & otherCard) {
-	const auto & otherSkill = otherCard.skill;
+void Live::updateMimic(const CardState & otherCard) {
+	const auto & otherSkill = cardData(otherCard).skill;
 	assert(otherSkill.valid);
 	if (otherSkill.effect == Skill::Effect::Mimic) {
 		return;
@@ -1120,8 +859,8 @@ void Live::updateMimic(const LiveCard & otherCard) {
 }
 
 
-bool Live::getMimic(LiveCard & card) {
-	assert(card.skill.valid && card.skill.effect == Skill::Effect::Mimic);
+bool Live::getMimic(CardState & card) {
+	assert(cardData(card).skill.valid && cardData(card).skill.effect == Skill::Effect::Mimic);
 	assert(time >= mimicStack.pushTime && time >= mimicStack.popTime);
 	if (mimicStack.popTime > mimicStack.pushTime) {
 		card.mimicSkillIndex = -1;
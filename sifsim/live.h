@@ -4,154 +4,34 @@
 #include <vector>
 #include <array>
 #include <deque>
-#include <string>
 #include <tuple>
 #include "optional.h"
 #include <cstdint>
 #include <climits>
-#include <cstdio>
-#include "pcg/pcg_random.hpp"
-#include "rapidjson/document.h"
-#include "note.h"
-#include "card.h"
+#include "livemodel.h"
+#include "judgment.h"
+#include "liveresult.h"
+#include "counterrandom.h"
+#include "activation.h"
+#include "scorebound.h"
 #include "util.h"
 
-#if USE_FAST_RANDOM
-#include "fastrandom.h"
-using FastRandom::BernoulliDistribution;
-using FastRandom::NormalDistribution;
-#else
-#include <random>
-using BernoulliDistribution = std::bernoulli_distribution;
-template <class RealType = double>
-using NormalDistribution = std::normal_distribution<RealType>;
-#endif
 
-
-class Live {
-public:
-	explicit Live(FILE * fp);
-	int simulate(uint64_t id, uint64_t seed = UINT64_C(0xcafef00dd15ea5e5));
-
-public:
-	static constexpr double FRAME_TIME = 0.016;
-	static constexpr std::array<std::pair<int, double>, 7> COMBO_MUL = { {
-		{50, 1},
-		{100, 1.1},
-		{200, 1.15},
-		{400, 1.2},
-		{600, 1.25},
-		{800, 1.3},
-		{INT_MAX, 1.35},
-	} };
-
-private:
-	struct LiveNote;
-	struct LiveCard;
-
-	void loadSettings(const rapidjson::Value & json);
-	void loadLiveBonus(const rapidjson::Value & json);
-	void loadSkillOrder(const rapidjson::Value & json);
-	void loadUnit(const rapidjson::Value & json);
-	void loadCharts(const rapidjson::Value & json);
-	void processUnit();
-	void processCharts();
-
-	void loadHitError(const rapidjson::Value & json);
-#if !SIMULATE_HIT_TIMING
-	void loadGreatRate(const rapidjson::Value & json);
-#endif
-
-	void initSimulation();
-	void initNextSong();
-	void initForEverySong();
-	void shuffleSkills();
-	void initSkills();
-	void initSkillsForNextSong();
-	void initSkillsForEverySong();
-
-	void simulateHitError();
-	void startSkillTrigger();
-	double computeScore(const LiveNote & note, bool isPerfect) const;
-
-	void skillTrigger(LiveCard & card);
-	void skillOn(LiveCard & card, bool isMimic);
-	void skillOff(LiveCard & card);
-	void skillSetNextTrigger(LiveCard & card);
-	void skillSetNextTriggerOnNextFrame(LiveCard & card);
-	void updateChain(const LiveCard & otherCard);
-	void updateMimic(const LiveCard & otherCard);
-	bool getMimic(LiveCard & card);
-
-private:
-	struct Hit {
-		double time;
-		int noteIndex;
-		bool isPerfect;
-		bool isHoldBegin;
-		bool isHoldEnd;
-		bool isSlide;
-
-		Hit() = default;
-		Hit(int noteIndex, const Note & note, bool isHoldEnd)
-			: time(isHoldEnd ? note.holdEndTime : note.time)
-			, noteIndex(noteIndex)
-			, isPerfect(true)
-			, isHoldBegin(note.isHold && !isHoldEnd)
-			, isHoldEnd(isHoldEnd)
-			, isSlide(note.isSlide) {}
-	};
-
-	struct LiveNote : public Note {
-		bool isHoldBeginPerfect;
-		double holdBeginHitTime;
-	};
-
-	struct LiveCard : public Card {
+// Per-thread simulation state
+struct LiveState {
+	struct CardState {
 		unsigned skillId;
 		int currentSkillLevel;
 		bool isActive;
 		int nextTrigger;
 		int remainingChainTypeNum;
-		std::vector<int> chainStatus;
+		unsigned chainStatus;
 		int mimicSkillIndex;
 		int mimicSkillLevel;
 		optional<double> buffedStatus;
 		optional<double> syncStatus;
-
-		const Skill::LevelData & skillLevel() const {
-			return skill.levels[currentSkillLevel - 1];
-		}
-
-		double getSyncStatus() const {
-			return syncStatus.value_or(buffedStatus.value_or(status));
-		}
-	};
-
-	struct LiveChart {
-		int memberCategory;
-		int beginNote;
-		int endNote;
-		double lastNoteShowTime;
-		std::vector<LiveNote> notes;
-	};
-
-	enum SkillIdFlags : unsigned {
-		SkillEventMask      = 0xf00000,
-		SkillOff            = 0x100000,
-		SkillNextTrigger    = 0x200000,
-		SkillOn             = 0x300000,
-		SkillPriorityMask   = 0xf0000,
-		ActiveSkill         = 0x10000,
-		PassiveSkill        = 0x20000,
-		SkillOrderMask      = 0xff00,
-		SkillIndexMask      = 0xff,
-	};
-	static constexpr int SKILL_ORDER_SHIFT = 8;
-
-	enum class LiveMode {
-		Normal = 0,
-		MF = 3,
+		ActivationRandom activationRng;
+		CounterRandom syncRng;
 	};
 
 	struct SkillEvent {
@@ -184,50 +64,14 @@ private:
 		int skillLevel;
 	};
 
-private:
-	pcg32 rng;
-
-	// Settings
-	LiveMode mode = LiveMode::Normal;
-	double hiSpeed = 0.7;
-	double judgeOffset = 0;
-	double hitPerfectWindow = 0.032;
-	double hitGreatWindow = 0.080;
-	double slidePerfectWindow = hitGreatWindow;
-	double slideGreatWindow = 0.128;
-#if SIMULATE_HIT_TIMING
-	NormalDistribution<> eHit{ 0, 0.015 };
-	NormalDistribution<> eHoldBegin{ 0, 0.015 };
-	NormalDistribution<> eHoldEnd{ 0, 0.015 };
-	NormalDistribution<> eSlide{ 0, 0.015 };
-#else
-	BernoulliDistribution gHit{ 0.05 };
-	BernoulliDistribution gHoldBegin{ 0.05 };
-	BernoulliDistribution gHoldEnd{ 0.05 };
-	BernoulliDistribution gSlide{ 0.05 };
-	BernoulliDistribution gSlideHoldEnd{ 0.05 };
-#endif
-
-	// Live bonus
-	double liveScoreRate = 1;
-	double liveActivationRate = 1;
-
-	// Skill order
-	std::vector<int> skillOrder;
+	CounterRandom shuffleRng;
 
 	// Unit
-	double unitStatus = 0;
-	double judgeSisStatus = 0;
-	std::vector<LiveCard> cards;
+	std::vector<CardState> cards;
 
-	// Chart
-	std::vector<LiveChart> charts;
-
-	// Simulation
 	// Basic
 	double status = 0;
 	size_t chartIndex = 0;
-	int chartMemberCategory = 0;
 	double chartScoreRate = 1;
 	double chartActivationRate = 1;
 	double time = 0;
@@ -236,18 +80,26 @@ private:
 	int combo = 0;
 	int perfect = 0;
 	int starPerfect = 0;
-	decltype(COMBO_MUL)::const_iterator itComboMul = COMBO_MUL.begin();
+	// Control variates, see LiveResult
+	std::array<int, LiveResult::COVARIATE_NUM> covariates = {};
+	decltype(LiveModel::COMBO_MUL)::const_iterator itComboMul = LiveModel::COMBO_MUL.begin();
 
-	// Pre calc
-	std::vector<std::vector<Hit>> chartHits;
-	std::vector<double> combos;
+	// Hit results of this iteration, judge skills change copies of a few of them
+	const HitJudgments * judgments = nullptr;
+	std::vector<std::vector<unsigned char>> holdBeginPerfects;
+	std::vector<std::vector<uint64_t>> perfectMasks;
 
 	// Skill trigger
 	MinPriorityQueue<SkillEvent> skillEvents;
 	MinPriorityQueue<SkillTrigger<double>> scoreTriggers;
 	MinPriorityQueue<SkillTrigger<>> perfectTriggers;
 	MinPriorityQueue<SkillTrigger<>> starPerfectTriggers;
-	std::vector<int> chainTriggers;
+	// Without judge skills perfects are counted from the masks lazily:
+	// hits [0, countedHit) are included in perfect and starPerfect,
+	// and the next perfect triggers fire at the hits below
+	int countedHit = 0;
+	int perfectTriggerHit = INT_MAX;
+	int starPerfectTriggerHit = INT_MAX;
 	MimicStack mimicStack{ -1, 0, 0, 0 };
 
 	// Skill effect
@@ -258,3 +110,127 @@ private:
 	std::deque<double> perfectBonusRateQueue;
 	double perfectBonusRate = 1;
 };
+
+
+class Live : private LiveState {
+public:
+	explicit Live(const LiveModel & model);
+	LiveResult simulate(uint64_t id, uint64_t seed = UINT64_C(0xcafef00dd15ea5e5));
+	// Uses judgments shared with other lives, see HitJudge::isShareable
+	LiveResult simulate(uint64_t id, uint64_t seed, const HitJudgments & hitJudgments);
+
+	// Odd ids take the complement of every random number of id - 1
+	void setAntithetic(bool value) {
+		antithetic = value;
+		judge.setAntithetic(value);
+	}
+
+	// Draws activation rolls from the QMC points, nullptr to turn off
+	void setQmc(const QmcPoints * points) {
+		qmc = points;
+	}
+
+	// For splitting: start() a live and run() it to a hit, then copy its state()
+	// and restore() it into lives that continue with their own reseed() and
+	// rejudge(). simulate() is start(), run() and result().
+	void start(uint64_t id, uint64_t seed, const HitJudgments & hitJudgments);
+	// Runs until hit stopHit of chart stopChart is next or the live ends,
+	// returns whether it ended
+	bool run(size_t stopChart = SIZE_MAX, int stopHit = INT_MAX);
+	LiveResult result() const;
+
+	const LiveState & state() const {
+		return *this;
+	}
+
+	void restore(const LiveState & state) {
+		static_cast<LiveState &>(*this) = state;
+	}
+
+	// Draws the remaining skill activations and sync targets from the streams of (seed, id)
+	void reseed(uint64_t id, uint64_t seed);
+	// Continues with hitJudgments, which shall agree with the current ones on
+	// the hits played so far, see HitJudge::splice. With hit timing the hits are
+	// sorted by judged time, so they shall be the same as the current ones.
+	void rejudge(const HitJudgments & hitJudgments);
+
+	// Importance sampling: activation odds are multiplied by e^tilt and great
+	// odds by e^-tilt, LiveResult::logWeight has the likelihood ratio. 0 to turn off.
+	void setTilt(double tilt) {
+		activationTilt.reset();
+		if (tilt != 0) {
+			activationTilt.emplace(tilt);
+		}
+		judge.setTilt(tilt);
+	}
+
+	// Threshold queries: run() stops as soon as the score reaches threshold or
+	// ScoreBound shows it can't, so result() only tells which. 0 to turn off.
+	void setThreshold(int threshold);
+
+private:
+	using Hit = LiveModel::Hit;
+
+	void seedCards(uint64_t id, uint64_t seed, bool complement);
+	void initSimulation();
+	void initNextSong();
+	void initForEverySong();
+	void initSkillOrder();
+	void shuffleSkills();
+	void initSkills();
+	void initSkillsForNextSong();
+	void initSkillsForEverySong();
+
+	void copyJudgments();
+	void startSkillTrigger();
+	double computeScore(const LiveModel::NoteMuls & noteMuls, bool isPerfect, bool isHoldBeginPerfect) const;
+	void countPerfects(int lastHit);
+	void firePerfectTriggers();
+	void updatePerfectTriggerHits();
+
+	void skillTrigger(CardState & card);
+	void skillOn(CardState & card, bool isMimic);
+	void skillOff(CardState & card);
+	void skillSetNextTrigger(CardState & card);
+	void skillSetNextTriggerOnNextFrame(CardState & card);
+	void updateChain(const CardState & otherCard);
+	void updateMimic(const CardState & otherCard);
+	bool getMimic(CardState & card);
+	bool thresholdDecided() const;
+
+	const Card & cardData(const CardState & card) const {
+		return model.cards[card.skillId & SkillIndexMask];
+	}
+
+	const Skill::LevelData & skillLevel(const CardState & card) const {
+		return cardData(card).skill.levels[card.currentSkillLevel - 1];
+	}
+
+	double getSyncStatus(const CardState & card) const {
+		return card.syncStatus.value_or(card.buffedStatus.value_or(cardData(card).status));
+	}
+
+private:
+	enum SkillIdFlags : unsigned {
+		SkillEventMask      = 0xf00000,
+		SkillOff            = 0x100000,
+		SkillNextTrigger    = 0x200000,
+		SkillOn             = 0x300000,
+		SkillPriorityMask   = 0xf0000,
+		ActiveSkill         = 0x10000,
+		PassiveSkill        = 0x20000,
+		SkillOrderMask      = 0xff00,
+		SkillIndexMask      = 0xff,
+	};
+	static constexpr int SKILL_ORDER_SHIFT = 8;
+
+private:
+	const LiveModel & model;
+	bool antithetic = false;
+	const QmcPoints * qmc = nullptr;
+	optional<ActivationTilt> activationTilt;
+	HitJudge judge;
+	HitJudgments ownJudgments;
+	int threshold = 0;
+	optional<ScoreBound> scoreBound;
+};
@@ -0,0 +1,508 @@
+#include "configure.h"
+#include "livemodel.h"
+#include "util.h"
+#include "rapidjson/document.h"
+#include "rapidjsonutil.h"
+#include "chartcache.h"
+#include <cmath>
+#include <stdexcept>
+#include <algorithm>
+#include <numeric>
+#include <type_traits>
+#include <cassert>
+#include <memory>
+
+using namespace std;
+using namespace std::literals;
+
+
+const auto compareTime = [](const auto & a, const auto & b) {
+	return a.time < b.time;
+};
+
+
+LiveModel::LiveModel(FILE * fp) : LiveModel(ParseJsonFile(fp)) {
+}
+
+
+LiveModel::LiveModel(const rapidjson::Value & doc, ChartCache * chartCache) {
+	if (!doc.IsObject()) {
+		throw JsonParseError("Invalid input");
+	}
+	loadSettings(GetJsonMember(doc, "settings"));
+	auto itLiveBonus = doc.FindMember("live_bonus");
+	if (itLiveBonus != doc.MemberEnd() && !itLiveBonus->value.IsNull()) {
+		loadLiveBonus(itLiveBonus->value);
+	}
+	auto itSkillOrder = doc.FindMember("skill_trigger_priority");
+	if (itSkillOrder != doc.MemberEnd() && !itSkillOrder->value.IsNull()) {
+		loadSkillOrder(itSkillOrder->value);
+	}
+	loadUnit(GetJsonMember(doc, "cards"));
+	loadCharts(GetJsonMember(doc, "lives"), chartCache);
+	processUnit();
+	processCharts();
+}
+
+
+void LiveModel::loadSettings(const rapidjson::Value & json) {
+	if (!json.IsObject()) {
+		throw JsonParseError("Invalid input: settings");
+	}
+	mode = static_cast<LiveMode>(GetJsonMemberInt(json, "mode"));
+	hiSpeed = GetJsonMemberDouble(json, "note_speed");
+	judgeOffset = TryGetJsonMemberDouble(json, "judge_offset").value_or(0);
+#if SIMULATE_HIT_TIMING
+	loadHitError(GetJsonMember(json, "hit_error"));
+#else
+	auto itJudgeWindow = json.FindMember("judge_window");
+	if (itJudgeWindow != json.MemberEnd() && !itJudgeWindow->value.IsNull()) {
+		auto & jsonJudgeWindow = itJudgeWindow->value;
+		if (!jsonJudgeWindow.IsArray() || jsonJudgeWindow.Size() < 3) {
+			throw JsonParseError("Invalid input: settings.judge_window");
+		}
+		hitPerfectWindow = GetJsonItemDouble(jsonJudgeWindow, 0);
+		hitGreatWindow = GetJsonItemDouble(jsonJudgeWindow, 1);
+		slidePerfectWindow = hitGreatWindow;
+		slideGreatWindow = GetJsonItemDouble(jsonJudgeWindow, 2);
+	} else {
+		constexpr double JUDGE_MIN_SPEED = 0.8;
+		constexpr double PLAYAREA_R = 400;
+		constexpr double PERFECT_WINDOW_TICKS = 16;
+		constexpr double GREAT_WINDOW_TICKS = 40;
+		constexpr double GOOD_WINDOW_TICKS = 64;
+		double judgeTick = fmax(hiSpeed, JUDGE_MIN_SPEED) / PLAYAREA_R;
+		hitPerfectWindow = judgeTick * PERFECT_WINDOW_TICKS;
+		hitGreatWindow = judgeTick * GREAT_WINDOW_TICKS;
+		slidePerfectWindow = hitGreatWindow;
+		slideGreatWindow = judgeTick * GOOD_WINDOW_TICKS;
+	}
+	auto itHitError = json.FindMember("hit_error");
+	if (itHitError != json.MemberEnd() && !itHitError->value.IsNull()) {
+		loadHitError(itHitError->value);
+	} else {
+		loadGreatRate(GetJsonMember(json, "hit_great_rate"));
+	}
+#endif
+}
+
+
+#if SIMULATE_HIT_TIMING
+
+void LiveModel::loadHitError(const rapidjson::Value & json) {
+	if (!json.IsObject()) {
+		throw JsonParseError("Invalid input: settings.hit_error");
+	}
+	const auto readParam = [](const rapidjson::Value & obj) {
+		double mean = TryGetJsonMemberDouble(obj, "mean").value_or(0);
+		double stddev = GetJsonMemberDouble(obj, "stddev");
+		return NormalDistribution<>::param_type(mean, stddev);
+	};
+	eHit.param(readParam(GetJsonMemberObject(json, "hit")));
+	eHoldBegin.param(readParam(GetJsonMemberObject(json, "hold_begin")));
+	eHoldEnd.param(readParam(GetJsonMemberObject(json, "hold_end")));
+	eSlide.param(readParam(GetJsonMemberObject(json, "slide")));
+}
+
+#else
+
+void LiveModel::loadHitError(const rapidjson::Value & json) {
+	if (!json.IsObject()) {
+		throw JsonParseError("Invalid input: settings.hit_error");
+	}
+	const auto readParam = [](const rapidjson::Value & obj, double window) {
+		constexpr double SQRT1_2 = 0.707106781186547524401;
+		double mean = TryGetJsonMemberDouble(obj, "mean").value_or(0);
+		double stddev = GetJsonMemberDouble(obj, "stddev");
+		double gRate = 0.5 * (erfc((window - mean) / stddev * SQRT1_2)
+			+ erfc((window + mean) / stddev * SQRT1_2));
+		return BernoulliDistribution::param_type(gRate);
+	};
+	gHit.param(readParam(GetJsonMemberObject(json, "hit"), hitPerfectWindow));
+	gHoldBegin.param(readParam(GetJsonMemberObject(json, "hold_begin"), hitPerfectWindow));
+	gHoldEnd.param(readParam(GetJsonMemberObject(json, "hold_end"), hitPerfectWindow));
+	gSlide.param(readParam(GetJsonMemberObject(json, "slide"), slidePerfectWindow));
+	gSlideHoldEnd.param(readParam(GetJsonMemberObject(json, "hold_end"), slidePerfectWindow));
+}
+
+
+void LiveModel::loadGreatRate(const rapidjson::Value & json) {
+	if (!json.IsObject()) {
+		throw JsonParseError("Invalid input: settings.hit_great_rate");
+	}
+	gHit.param(BernoulliDistribution::param_type(GetJsonMemberDouble(json, "hit")));
+	gHoldBegin.param(BernoulliDistribution::param_type(GetJsonMemberDouble(json, "hold_begin")));
+	gHoldEnd.param(BernoulliDistribution::param_type(GetJsonMemberDouble(json, "hold_end")));
+	gSlide.param(BernoulliDistribution::param_type(GetJsonMemberDouble(json, "slide")));
+	gSlideHoldEnd.param(BernoulliDistribution::param_type(GetJsonMemberDouble(json, "hold_end")));
+}
+
+#endif
+
+
+void LiveModel::loadLiveBonus(const rapidjson::Value & json) {
+	if (!json.IsObject()) {
+		throw JsonParseError("Invalid input: live_bonus");
+	}
+	liveScoreRate = TryGetJsonMemberDouble(json, "bonus_score_rate").value_or(1);
+	liveActivationRate = TryGetJsonMemberDouble(json, "bonus_activation_rate").value_or(1);
+	auto itGuestBonus = json.FindMember("guest_bonus");
+	if (itGuestBonus != json.MemberEnd() && !itGuestBonus->value.IsNull()) {
+		// TODO: load MF guest bonus
+		throw runtime_error("MF guest bonus not implemented");
+	}
+}
+
+
+void LiveModel::loadSkillOrder(const rapidjson::Value & json) {
+	if (!json.IsArray()) {
+		throw JsonParseError("Invalid input: skill_trigger_priority");
+	}
+	for (const auto & i : json.GetArray()) {
+		if (!i.IsInt()) {
+			throw JsonParseError("Invalid input: skill_trigger_priority");
+		}
+		skillOrder.emplace_back(i.GetInt());
+	}
+}
+
+
+void LiveModel::loadUnit(const rapidjson::Value & json) {
+	if (!json.IsArray()) {
+		throw JsonParseError("Invalid input: cards");
+	}
+	unitStatus = 0;
+	judgeSisStatus = 0;
+	cards.reserve(json.Size());
+	for (const auto & jsonCard : json.GetArray()) {
+		if (!jsonCard.IsObject()) {
+			throw JsonParseError("Invalid input: cards");
+		}
+		cards.emplace_back();
+		auto & card = cards.back();
+		card.type = GetJsonMemberInt(jsonCard, "unit_type");
+		card.category = GetJsonMemberInt(jsonCard, "member_category");
+		card.attribute = GetJsonMemberInt(jsonCard, "attribute");
+		card.baseStatus = GetJsonMemberInt(jsonCard, "base_status");
+		card.status = GetJsonMemberInt(jsonCard, "status");
+		unitStatus += card.status;
+
+		auto & skill = card.skill;
+		auto itSkill = jsonCard.FindMember("skill");
+		if (itSkill == jsonCard.MemberEnd() || itSkill->value.IsNull()) {
+			skill.effect = Skill::Effect::None;
+		} else {
+			const auto & jsonSkill = itSkill->value;
+			if (!jsonSkill.IsObject()) {
+				throw JsonParseError("Invalid input: cards[].skill");
+			}
+			skill.effect = static_cast<Skill::Effect>(GetJsonMemberInt(jsonSkill, "effect_type"));
+			skill.discharge = static_cast<Skill::Discharge>(GetJsonMemberInt(jsonSkill, "discharge_type"));
+			skill.trigger = static_cast<Skill::Trigger>(GetJsonMemberInt(jsonSkill, "trigger_type"));
+			skill.level = GetJsonMemberInt(jsonSkill, "level");
+			auto itEffectTargets = jsonSkill.FindMember("effect_targets");
+			if (itEffectTargets != jsonSkill.MemberEnd() && !itEffectTargets->value.IsNull()) {
+				const auto & jsonEffectTargets = itEffectTargets->value;
+				if (!jsonEffectTargets.IsArray()) {
+					throw JsonParseError("Invalid input: cards[].skill.effect_targets");
+				}
+				for (const auto & target : jsonEffectTargets.GetArray()) {
+					if (!target.IsInt()) {
+						throw JsonParseError("Invalid input: cards[].skill.effect_targets");
+					}
+					skill.effectTargets.emplace_back(target.GetInt());
+				}
+			}
+			auto itTriggerTargets = jsonSkill.FindMember("trigger_targets");
+			if (itTriggerTargets != jsonSkill.MemberEnd() && !itTriggerTargets->value.IsNull()) {
+				const auto & jsonTriggerTargets = itTriggerTargets->value;
+				if (!jsonTriggerTargets.IsArray()) {
+					throw JsonParseError("Invalid input: cards[].skill.trigger_targets");
+				}
+				for (const auto & target : jsonTriggerTargets.GetArray()) {
+					if (!target.IsInt()) {
+						throw JsonParseError("Invalid input: cards[].skill.trigger_targets");
+					}
+					skill.chainTargets.emplace_back(target.GetInt());
+				}
+			}
+			const auto & jsonLevels = GetJsonMemberArray(jsonSkill, "levels");
+			for (const auto & jsonLevel : jsonLevels.GetArray()) {
+				if (!jsonLevel.IsObject()) {
+					throw JsonParseError("Invalid input: cards[].skill.levels");
+				}
+				skill.levels.emplace_back();
+				auto & level = skill.levels.back();
+				level.effectValue = GetJsonMemberDouble(jsonLevel, "effect_value");
+				level.dischargeTime = GetJsonMemberDouble(jsonLevel, "discharge_time");
+				level.triggerValue = GetJsonMemberInt(jsonLevel, "trigger_value");
+				level.activationRate = GetJsonMemberInt(jsonLevel, "activation_rate");
+			}
+			auto itSisList = jsonCard.FindMember("school_idol_skills");
+			if (itSisList != jsonCard.MemberEnd() && !itSisList->value.IsNull()) {
+				// Translate SIS effect, assume FC
+				const auto & jsonSisList = itSisList->value;
+				if (!jsonSisList.IsObject()) {
+					throw JsonParseError("Invalid input: cards[].skill.school_idol_skills");
+				}
+				auto charm = TryGetJsonMemberDouble(jsonSisList, "charm");
+				if (charm && skill.effect == Skill::Effect::ScorePlus) {
+					for (auto & level : skill.levels) {
+						level.effectValue += Ceil(level.effectValue * *charm / 100.0);
+					}
+				}
+				auto trick = TryGetJsonMemberDouble(jsonSisList, "trick");
+				if (trick) {
+					judgeSisStatus += Ceil(card.baseStatus * *trick / 100.0);
+				}
+				auto heal = TryGetJsonMemberDouble(jsonSisList, "heal");
+				if (heal && skill.effect == Skill::Effect::HpRestore) {
+					skill.effect = Skill::Effect::ScorePlus;
+					for (auto & level : skill.levels) {
+						level.effectValue *= *heal;
+					}
+				}
+			}
+		}
+	}
+}
+
+
+void LiveModel::processUnit() {
+	// Check skill order
+	if (!skillOrder.empty()) {
+		if (skillOrder.size() != cards.size()) {
+			throw runtime_error("Invalid skill trigger order");
+		}
+		vector<unsigned char> check(skillOrder.size(), false);
+		for (auto i : skillOrder) {
+			if (i < 0 || i >= check.size() || exchange(check[i], true)) {
+				throw runtime_error("Invalid skill trigger order");
+			}
+		}
+	}
+
+	for (auto & card : cards) {
+		auto & skill = card.skill;
+		// Chain status is kept as a bit mask
+		if (skill.trigger == Skill::Trigger::Chain && skill.chainTargets.size() > CHAR_BIT * sizeof(unsigned)) {
+			throw runtime_error("Too many chain targets");
+		}
+		// Ignore nop skills (assume FC)
+		switch (skill.effect) {
+		case Skill::Effect::GreatToPerfect:
+		case Skill::Effect::GoodToPerfect:
+		case Skill::Effect::ScorePlus:
+		case Skill::Effect::SkillRateUp:
+		case Skill::Effect::Mimic:
+		case Skill::Effect::PerfectBonusRatio:
+		case Skill::Effect::PerfectBonusFixedValue:
+		case Skill::Effect::SyncStatus:
+		case Skill::Effect::GainStatus:
+			skill.valid = true;
+			break;
+
+		case Skill::Effect::None:
+		case Skill::Effect::HpRestore:
+			skill.valid = false;
+			break;
+
+		case Skill::Effect::GainSkillLevel:
+			throw runtime_error("Skill level boost not implemented");
+
+		case Skill::Effect::ComboBonusRatio:
+		case Skill::Effect::ComboBonusFixedValue:
+			throw runtime_error("Combo fever not implemented");
+
+		default:
+			throw runtime_error("Unknown skill effect type: "
+				+ to_string(static_cast<underlying_type_t<Skill::Effect>>(skill.effect)));
+		}
+
+		for (auto target : skill.effectTargets) {
+			if (target < 0 || target >= cards.size()) {
+				throw JsonParseError("Invalid skill target list");
+			}
+		}
+	}
+}
+
+
+void LiveModel::loadCharts(const rapidjson::Value & json, ChartCache * chartCache) {
+	if (!json.IsArray()) {
+		throw JsonParseError("Invalid input: lives");
+	}
+	charts.reserve(json.Size());
+	int totalNotes = 0;
+	for (const auto & jsonChart : json.GetArray()) {
+		if (!jsonChart.IsObject()) {
+			throw JsonParseError("Invalid input: lives");
+		}
+		charts.emplace_back();
+		auto & chart = charts.back();
+
+		shared_ptr<const ChartData> data;
+		auto path = TryGetJsonMemberString(jsonChart, "livejson_path");
+		if (path && chartCache) {
+			data = chartCache->load(*path);
+		} else if (path) {
+			auto livejson = ParseJsonFile(CFileWrapper(*path, "rb"));
+			if (!livejson.IsArray()) {
+				throw JsonParseError("Invalid livejson file: "s + *path);
+			}
+			data = make_shared<const ChartData>(processChart(loadNotes(livejson)));
+		} else {
+			data = make_shared<const ChartData>(processChart(loadNotes(GetJsonMemberArray(jsonChart, "livejson"))));
+		}
+
+		chart.notes = data->notes;
+		chart.memberCategory = GetJsonMemberInt(jsonChart, "member_category");
+		int noteNum = static_cast<int>(chart.notes.size());
+		chart.beginNote = totalNotes;
+		totalNotes += noteNum;
+		chart.endNote = totalNotes;
+		for (auto & note : chart.notes) {
+			note.showTime = note.time - hiSpeed;
+		}
+		chart.lastNoteShowTime = chart.notes.empty() ? 0 : chart.notes.back().showTime;
+
+		chartHits.push_back(data->hits);
+		combos.insert(combos.end(), data->comboTimes.begin(), data->comboTimes.end());
+		assert(combos.size() == chart.endNote);
+#if !SIMULATE_HIT_TIMING
+		chartPerfectMasks.push_back(data->perfectMask);
+		chartStarMasks.push_back(data->starMask);
+		holdEndHits.push_back(data->holdEndHits);
+		int chartIndex = static_cast<int>(charts.size()) - 1;
+		for (int c = 0; c < HIT_CLASS_NUM; c++) {
+			for (int i : data->classHits[c]) {
+				const auto & hit = data->hits[i];
+				classHits[c].push_back({ chartIndex, i, hit.isHoldBegin ? hit.noteIndex : -1 });
+			}
+		}
+#endif
+	}
+}
+
+
+vector<Note> LiveModel::loadNotes(const rapidjson::Value & json) {
+	if (!json.IsArray()) {
+		throw JsonParseError("Invalid livejson");
+	}
+	vector<Note> notes;
+	notes.reserve(json.Size());
+	for (const auto & noteObj : json.GetArray()) {
+		if (!noteObj.IsObject()) {
+			throw JsonParseError("Invalid livejson");
+		}
+		notes.emplace_back();
+		auto & note = notes.back();
+
+		note.position = GetJsonMemberInt(noteObj, "position");
+		note.attribute = GetJsonMemberInt(noteObj, "notes_attribute");
+		note.effect(static_cast<Note::Effect>(GetJsonMemberInt(noteObj, "effect")));
+		double t = GetJsonMemberDouble(noteObj, "timing_sec");
+		// SIF built-in offset :<
+		note.time = t - 0.1;
+		note.showTime = NAN;
+		if (note.isHold) {
+			note.holdEndTime = note.time + GetJsonMemberDouble(noteObj, "effect_value");
+		} else {
+			note.holdEndTime = NAN;
+		}
+	}
+	if (!is_sorted(notes.begin(), notes.end(), compareTime)) {
+		sort(notes.begin(), notes.end(), compareTime);
+	}
+	return notes;
+}
+
+
+LiveModel::ChartData LiveModel::processChart(vector<Note> notes) {
+	ChartData data;
+	data.notes = move(notes);
+	auto & hits = data.hits;
+	for (size_t i = 0; i < data.notes.size(); i++) {
+		const auto & note = data.notes[i];
+		hits.emplace_back(static_cast<int>(i), note, false);
+		if (note.isHold) {
+			hits.emplace_back(static_cast<int>(i), note, true);
+		}
+	}
+	sort(hits.begin(), hits.end(), compareTime);
+
+	for (const auto & h : hits) {
+		if (!h.isHoldBegin) {
+			data.comboTimes.emplace_back(h.time);
+		}
+	}
+
+#if !SIMULATE_HIT_TIMING
+	size_t words = (hits.size() + 63) / 64;
+	data.perfectMask.resize(words);
+	data.starMask.resize(words);
+	data.holdEndHits.assign(data.notes.size(), -1);
+	for (size_t i = 0; i < hits.size(); i++) {
+		const auto & hit = hits[i];
+		int bit = static_cast<int>(i);
+		HitClass hitClass;
+		if (hit.isSlide) {
+			hitClass = hit.isHoldEnd ? HitClassSlideHoldEnd : HitClassSlide;
+		} else if (hit.isHoldBegin) {
+			hitClass = HitClassHoldBegin;
+		} else if (hit.isHoldEnd) {
+			hitClass = HitClassHoldEnd;
+		} else {
+			hitClass = HitClassHit;
+		}
+		data.classHits[hitClass].push_back(bit);
+		if (hit.isHoldBegin) {
+			continue;
+		}
+		setBit(data.perfectMask, bit);
+		if (data.notes[hit.noteIndex].isBomb) {
+			setBit(data.starMask, bit);
+		}
+		if (hit.isHoldEnd) {
+			data.holdEndHits[hit.noteIndex] = bit;
+		}
+	}
+#endif
+	return data;
+}
+
+
+void LiveModel::processCharts() {
+	int cardNum = static_cast<int>(cards.size());
+	for (auto & chart : charts) {
+		// In livejson, leftmost = 9, rightmost = 1
+		// Transform to leftmost = 0, rightmost = 8
+		for (auto & note : chart.notes) {
+			if (note.position <= 0 || note.position > cardNum) {
+				throw runtime_error("Invalid note position: " + to_string(note.position));
+			}
+			note.position = cardNum - note.position;
+		}
+
+		chartNoteMuls.emplace_back();
+		auto & noteMuls = chartNoteMuls.back();
+		noteMuls.reserve(chart.notes.size());
+		for (const auto & note : chart.notes) {
+			const auto & card = cards[note.position];
+			NoteMuls muls;
+			muls.category = card.category == chart.memberCategory ? 1.1 : 1;
+			muls.hold = note.isHold ? array<double, 2>{ 1.1, 1.25 } : array<double, 2>{ 1, 1 };
+			muls.slide = note.isSlide ? 0.5 : 1;
+			muls.attribute = card.attribute == note.attribute ? 1.1 : 1;
+			noteMuls.push_back(muls);
+		}
+	}
+
+#if !SIMULATE_HIT_TIMING
+	greatGaps[HitClassHit] = GeometricDistribution<>(gHit.p());
+	greatGaps[HitClassHoldBegin] = GeometricDistribution<>(gHoldBegin.p());
+	greatGaps[HitClassHoldEnd] = GeometricDistribution<>(gHoldEnd.p());
+	greatGaps[HitClassSlide] = GeometricDistribution<>(gSlide.p());
+	greatGaps[HitClassSlideHoldEnd] = GeometricDistribution<>(gSlideHoldEnd.p());
+#endif
+}
@@ -0,0 +1,215 @@
+#pragma once
+#include "configure.h"
+
+#include <vector>
+#include <array>
+#include <utility>
+#include "optional.h"
+#include <cstdint>
+#include <climits>
+#include <cstdio>
+#include "rapidjson/document.h"
+#include "note.h"
+#include "card.h"
+#include "util.h"
+
+#if USE_FAST_RANDOM
+#include "fastrandom.h"
+using FastRandom::BernoulliDistribution;
+using FastRandom::NormalDistribution;
+using FastRandom::GeometricDistribution;
+#else
+#include <random>
+using BernoulliDistribution = std::bernoulli_distribution;
+template <class IntType = uint64_t>
+using GeometricDistribution = std::geometric_distribution<IntType>;
+template <class RealType = double>
+using NormalDistribution = std::normal_distribution<RealType>;
+#endif
+
+
+class ChartCache;
+
+
+// Read-only live data shared by all simulation threads
+class LiveModel {
+public:
+	explicit LiveModel(FILE * fp);
+	// Charts given by livejson_path are taken from chartCache if not null
+	explicit LiveModel(const rapidjson::Value & json, ChartCache * chartCache = nullptr);
+
+	// Parses livejson notes, sorted by time. Positions are not transformed yet
+	// and showTime is left for the model, as both depend on the unit and settings.
+	static std::vector<Note> loadNotes(const rapidjson::Value & json);
+
+public:
+	static constexpr double FRAME_TIME = 0.016;
+	static constexpr std::array<std::pair<int, double>, 7> COMBO_MUL = { {
+		{50, 1},
+		{100, 1.1},
+		{200, 1.15},
+		{400, 1.2},
+		{600, 1.25},
+		{800, 1.3},
+		{INT_MAX, 1.35},
+	} };
+
+	enum class LiveMode {
+		Normal = 0,
+		MF = 3,
+	};
+
+	struct Hit {
+		double time;
+		int noteIndex;
+#if SIMULATE_HIT_TIMING
+		bool isPerfect;
+#endif
+		bool isHoldBegin;
+		bool isHoldEnd;
+		bool isSlide;
+
+		Hit() = default;
+		Hit(int noteIndex, const Note & note, bool isHoldEnd)
+			: time(isHoldEnd ? note.holdEndTime : note.time)
+			, noteIndex(noteIndex)
+#if SIMULATE_HIT_TIMING
+			, isPerfect(true)
+#endif
+			, isHoldBegin(note.isHold && !isHoldEnd)
+			, isHoldEnd(isHoldEnd)
+			, isSlide(note.isSlide) {}
+	};
+
+#if !SIMULATE_HIT_TIMING
+	// Hits sharing a great rate
+	enum HitClass {
+		HitClassHit,
+		HitClassHoldBegin,
+		HitClassHoldEnd,
+		HitClassSlide,
+		HitClassSlideHoldEnd,
+		HIT_CLASS_NUM,
+	};
+
+	struct HitRef {
+		int chart;
+		int hit;
+		// Note of a hold begin, -1 for other hits
+		int holdBeginNote;
+	};
+#endif
+
+	// Static score multipliers of a note, 1 where they don't apply
+	struct NoteMuls {
+		double category;
+		// Indexed by whether the hold begin is perfect
+		std::array<double, 2> hold;
+		double slide;
+		double attribute;
+
+		// One by one in the order computeScore always used, a factor of 1 is exact
+		double apply(double noteScore, bool isHoldBeginPerfect) const {
+			noteScore *= category;
+			noteScore *= hold[isHoldBeginPerfect];
+			noteScore *= slide;
+			noteScore *= attribute;
+			return noteScore;
+		}
+	};
+
+	struct LiveChart {
+		int memberCategory;
+		int beginNote;
+		int endNote;
+		double lastNoteShowTime;
+		std::vector<Note> notes;
+	};
+
+	// Chart data that doesn't depend on the unit or settings, shareable between models
+	struct ChartData {
+		// As loaded by loadNotes
+		std::vector<Note> notes;
+		// Hits sorted by time
+		std::vector<Hit> hits;
+		// Time of each hit that adds to the combo
+		std::vector<double> comboTimes;
+#if !SIMULATE_HIT_TIMING
+		// See chartPerfectMasks, chartStarMasks and holdEndHits
+		std::vector<uint64_t> perfectMask;
+		std::vector<uint64_t> starMask;
+		std::vector<int> holdEndHits;
+		// Hits of each class, see classHits
+		std::array<std::vector<int>, HIT_CLASS_NUM> classHits;
+#endif
+	};
+
+	static ChartData processChart(std::vector<Note> notes);
+
+private:
+	void loadSettings(const rapidjson::Value & json);
+	void loadLiveBonus(const rapidjson::Value & json);
+	void loadSkillOrder(const rapidjson::Value & json);
+	void loadUnit(const rapidjson::Value & json);
+	void loadCharts(const rapidjson::Value & json, ChartCache * chartCache);
+	void processUnit();
+	void processCharts();
+
+	void loadHitError(const rapidjson::Value & json);
+#if !SIMULATE_HIT_TIMING
+	void loadGreatRate(const rapidjson::Value & json);
+#endif
+
+public:
+	// Settings
+	LiveMode mode = LiveMode::Normal;
+	double hiSpeed = 0.7;
+	double judgeOffset = 0;
+	double hitPerfectWindow = 0.032;
+	double hitGreatWindow = 0.080;
+	double slidePerfectWindow = hitGreatWindow;
+	double slideGreatWindow = 0.128;
+#if SIMULATE_HIT_TIMING
+	NormalDistribution<> eHit{ 0, 0.015 };
+	NormalDistribution<> eHoldBegin{ 0, 0.015 };
+	NormalDistribution<> eHoldEnd{ 0, 0.015 };
+	NormalDistribution<> eSlide{ 0, 0.015 };
+#else
+	BernoulliDistribution gHit{ 0.05 };
+	BernoulliDistribution gHoldBegin{ 0.05 };
+	BernoulliDistribution gHoldEnd{ 0.05 };
+	BernoulliDistribution gSlide{ 0.05 };
+	BernoulliDistribution gSlideHoldEnd{ 0.05 };
+#endif
+
+	// Live bonus
+	double liveScoreRate = 1;
+	double liveActivationRate = 1;
+
+	// Skill order
+	std::vector<int> skillOrder;
+
+	// Unit
+	double unitStatus = 0;
+	double judgeSisStatus = 0;
+	std::vector<Card> cards;
+	std::vector<int> chainTriggers;
+
+	// Chart
+	std::vector<LiveChart> charts;
+
+	// Pre calc
+	std::vector<std::vector<Hit>> chartHits;
+	std::vector<std::vector<NoteMuls>> chartNoteMuls;
+	std::vector<double> combos;
+#if !SIMULATE_HIT_TIMING
+	// Hits of each class in chart order
+	std::array<std::vector<HitRef>, HIT_CLASS_NUM> classHits;
+	std::array<GeometricDistribution<>, HIT_CLASS_NUM> greatGaps;
+	// Bit i: hit i counts for PerfectCount (not a hold begin) / StarPerfect (star note)
+	std::vector<std::vector<uint64_t>> chartPerfectMasks;
+	std::vector<std::vector<uint64_t>> chartStarMasks;
+	// Hit index of the hold end of each note, -1 if not a hold
+	std::vector<std::vector<int>> holdEndHits;
+#endif
+};
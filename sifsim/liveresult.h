@@ -0,0 +1,52 @@
+#pragma once
+#include "configure.h"
+
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include "livemodel.h"
+
+
+// Score of one iteration and covariates whose means are known without
+// simulating, so they can serve as control variates.
+struct LiveResult {
+	// Cards past the last slot share it
+	static constexpr int CARD_SLOTS = 9;
+#if SIMULATE_HIT_TIMING
+	// Greats follow from the timing distributions and aren't counted
+	static constexpr int GREATS_NUM = 0;
+#else
+	static constexpr int GREATS_NUM = LiveModel::HIT_CLASS_NUM;
+#endif
+	static constexpr int GREATS_FIRST = 0;
+	static constexpr int ACTIVATIONS_FIRST = GREATS_FIRST + GREATS_NUM;
+	static constexpr int COVARIATE_NUM = ACTIVATIONS_FIRST + CARD_SLOTS;
+
+	int score = 0;
+	// [GREATS_FIRST + c]: raw greats of hit class c
+	// [ACTIVATIONS_FIRST + card]: 100 * activations - the activation percent of every roll
+	std::array<int, COVARIATE_NUM> covariates = {};
+	// Log likelihood ratio of the draws with importance sampling, 0 otherwise
+	double logWeight = 0;
+
+	static int activationSlot(size_t card) {
+		return ACTIVATIONS_FIRST + static_cast<int>(std::min<size_t>(card, CARD_SLOTS - 1));
+	}
+};
+
+
+// Means of LiveResult::covariates
+inline std::array<double, LiveResult::COVARIATE_NUM> CovariateMeans(const LiveModel & model) {
+	std::array<double, LiveResult::COVARIATE_NUM> means = {};
+#if !SIMULATE_HIT_TIMING
+	// Every hit of a class is great independently
+	for (int c = 0; c < LiveModel::HIT_CLASS_NUM; c++) {
+		double p = model.greatGaps[c].p() > 0 ? std::min(model.greatGaps[c].p(), 1.) : 0;
+		means[LiveResult::GREATS_FIRST + c] = p * model.classHits[c].size();
+	}
+#else
+	(void)model;
+#endif
+	// Activation covariates have mean 0, each roll succeeds with its own percent
+	return means;
+}
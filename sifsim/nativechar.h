@@ -1,6 +1,9 @@
 #pragma once
 
 #include <string>
+#include <cstdio>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #if _WIN32
 
@@ -12,6 +15,10 @@ typedef std::wstring NativeString;
 #define REQUIRE_CHARSET_CONVERSION 1
 #define NativeMain wmain
 #define NativeFopen _wfopen
+#define NativeRename _wrename
+#define NativeRemove _wremove
+#define NativeStat _wstat64
+typedef struct _stat64 NativeStatBuf;
 
 inline std::string ToUtf8(const NativeString & nativeStr) {
 	return std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>>().to_bytes(nativeStr);
@@ -27,6 +34,10 @@ typedef char NativeChar;
 typedef std::string NativeString;
 #define REQUIRE_CHARSET_CONVERSION 0
 #define NativeFopen std::fopen
+#define NativeRename std::rename
+#define NativeRemove std::remove
+#define NativeStat stat
+typedef struct stat NativeStatBuf;
 
 inline std::string ToUtf8(const NativeString & nativeStr) {
 	return nativeStr;
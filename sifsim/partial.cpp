@@ -0,0 +1,147 @@
+#include "partial.h"
+#include "rapidjsonutil.h"
+#include "rapidjson/writer.h"
+#include "rapidjson/stringbuffer.h"
+#include "util.h"
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+using namespace std::literals;
+
+
+constexpr const char * PARTIAL_FORMAT = "sifsim-partial";
+constexpr int PARTIAL_VERSION = 1;
+
+
+void SavePartialResult(const char * filename, const PartialResult & partial) {
+	const auto & stats = partial.stats;
+	rapidjson::StringBuffer buffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+	writer.StartObject();
+	writer.Key("format");
+	writer.String(PARTIAL_FORMAT);
+	writer.Key("version");
+	writer.Int(PARTIAL_VERSION);
+	writer.Key("seed");
+	writer.Uint64(partial.seed);
+	writer.Key("input_hash");
+	writer.Uint64(partial.inputHash);
+	writer.Key("first");
+	writer.Uint64(partial.first);
+	writer.Key("last");
+	writer.Uint64(partial.last);
+	writer.Key("count");
+	writer.Uint64(stats.count());
+	if (stats.count()) {
+		writer.Key("mean");
+		writer.Double(stats.mean());
+		writer.Key("m2");
+		writer.Double(stats.sumSquaredDeviations());
+		writer.Key("min");
+		writer.Int(stats.min());
+		writer.Key("max");
+		writer.Int(stats.max());
+	}
+	// [score, count] pairs in ascending score order
+	writer.Key("histogram");
+	writer.StartArray();
+	stats.histogram().forEach([&](int score, uint64_t count) {
+		writer.StartArray();
+		writer.Int(score);
+		writer.Uint64(count);
+		writer.EndArray();
+	});
+	writer.EndArray();
+	writer.EndObject();
+
+	// Written aside first, so an interrupted save never leaves a broken file
+	string tempFilename = filename + ".tmp"s;
+	{
+		CFileWrapper file(tempFilename.c_str(), "wb");
+		if (fwrite(buffer.GetString(), 1, buffer.GetSize(), file) != buffer.GetSize()
+			|| fputc('\n', file) == EOF || fflush(file) != 0) {
+			throw runtime_error("Cannot write file: "s + filename);
+		}
+	}
+	replaceFile(tempFilename.c_str(), filename);
+}
+
+
+static uint64_t GetPartialUint64(const rapidjson::Value & json, const char * name) {
+	auto u = TryGetJsonMemberUint64(json, name);
+	if (!u) {
+		throw JsonParseError("JSON: Member not found: "s + name);
+	}
+	return *u;
+}
+
+
+PartialResult LoadPartialResult(const char * filename) {
+	auto json = ParseJsonFile(CFileWrapper(filename, "rb"));
+	if (!json.IsObject()) {
+		throw JsonParseError("Invalid partial result: "s + filename);
+	}
+	auto format = TryGetJsonMemberString(json, "format");
+	if (!format || strcmp(*format, PARTIAL_FORMAT) != 0 || GetJsonMemberInt(json, "version") != PARTIAL_VERSION) {
+		throw JsonParseError("Unsupported partial result: "s + filename);
+	}
+
+	PartialResult partial;
+	partial.seed = GetPartialUint64(json, "seed");
+	partial.inputHash = GetPartialUint64(json, "input_hash");
+	partial.first = GetPartialUint64(json, "first");
+	partial.last = GetPartialUint64(json, "last");
+	uint64_t count = GetPartialUint64(json, "count");
+	if (partial.last < partial.first || partial.last - partial.first != count) {
+		throw JsonParseError("Invalid partial result: "s + filename);
+	}
+	ScoreHistogram hist;
+	for (const auto & item : GetJsonMemberArray(json, "histogram").GetArray()) {
+		if (!item.IsArray() || item.Size() != 2 || !item[0].IsInt() || !item[1].IsUint64()) {
+			throw JsonParseError("Invalid partial result: "s + filename);
+		}
+		hist.add(item[0].GetInt(), item[1].GetUint64());
+	}
+	if (hist.count() != count) {
+		throw JsonParseError("Invalid partial result: "s + filename);
+	}
+	if (count) {
+		partial.stats = ScoreStatistics(count,
+			GetJsonMemberDouble(json, "mean"), GetJsonMemberDouble(json, "m2"),
+			GetJsonMemberInt(json, "min"), GetJsonMemberInt(json, "max"), move(hist));
+	}
+	return partial;
+}
+
+
+PartialResult MergePartialResults(vector<PartialResult> partials) {
+	if (partials.empty()) {
+		throw invalid_argument("Nothing to merge");
+	}
+	sort(partials.begin(), partials.end(), [](const auto & a, const auto & b) {
+		return a.first < b.first;
+	});
+	PartialResult merged = move(partials.front());
+	for (auto it = partials.begin() + 1; it != partials.end(); ++it) {
+		if (it->seed != merged.seed) {
+			throw runtime_error("Cannot merge results of different seeds");
+		}
+		if (it->inputHash != merged.inputHash) {
+			throw runtime_error("Cannot merge results of different inputs");
+		}
+		if (it->first < merged.last) {
+			throw runtime_error("Iteration ranges overlap at " + to_string(it->first));
+		}
+		if (it->first > merged.last) {
+			throw runtime_error("Iterations " + to_string(merged.last) + " to "
+				+ to_string(it->first - 1) + " are missing");
+		}
+		merged.last = it->last;
+		merged.stats.merge(it->stats);
+	}
+	return merged;
+}
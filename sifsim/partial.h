@@ -0,0 +1,24 @@
+#pragma once
+#include "configure.h"
+
+#include <vector>
+#include <cstdint>
+#include "statistics.h"
+
+
+// Statistics of the contiguous iteration ids [first, last), as saved by --save-partial.
+// Results of runs over adjacent ranges with the same seed and input merge exactly.
+struct PartialResult {
+	uint64_t seed = 0;
+	uint64_t inputHash = 0;
+	uint64_t first = 0;
+	uint64_t last = 0;
+	ScoreStatistics stats;
+};
+
+void SavePartialResult(const char * filename, const PartialResult & partial);
+PartialResult LoadPartialResult(const char * filename);
+
+// Merges results in id order. Throws if seeds or inputs differ, or if the
+// ranges overlap or leave a gap.
+PartialResult MergePartialResults(std::vector<PartialResult> partials);
@@ -0,0 +1,115 @@
+#include "qmc.h"
+#include <stdexcept>
+
+using namespace std;
+
+
+// Product of polynomials over GF(2) modulo poly of the given degree
+static uint64_t MulMod(uint64_t a, uint64_t b, uint64_t poly, int degree) {
+	uint64_t r = 0;
+	for (; b; b >>= 1) {
+		if (b & 1) {
+			r ^= a;
+		}
+		a <<= 1;
+		if (a >> degree & 1) {
+			a ^= poly;
+		}
+	}
+	return r;
+}
+
+
+static uint64_t PowMod(uint64_t e, uint64_t poly, int degree) {
+	uint64_t r = 1;
+	uint64_t x = MulMod(1, 2, poly, degree);
+	for (; e; e >>= 1) {
+		if (e & 1) {
+			r = MulMod(r, x, poly, degree);
+		}
+		x = MulMod(x, x, poly, degree);
+	}
+	return r;
+}
+
+
+// Whether x has order 2^degree - 1 modulo poly
+static bool IsPrimitive(uint64_t poly, int degree) {
+	uint64_t order = (UINT64_C(1) << degree) - 1;
+	if (PowMod(order, poly, degree) != 1) {
+		return false;
+	}
+	uint64_t m = order;
+	for (uint64_t q = 2; q * q <= m; q++) {
+		if (m % q == 0) {
+			if (PowMod(order / q, poly, degree) == 1) {
+				return false;
+			}
+			while (m % q == 0) {
+				m /= q;
+			}
+		}
+	}
+	return m == 1 || PowMod(order / m, poly, degree) != 1;
+}
+
+
+SobolSequence::SobolSequence(size_t dimensions) : directions(dimensions * BITS) {
+	if (dimensions == 0) {
+		return;
+	}
+	for (int k = 0; k < BITS; k++) {
+		directions[k] = UINT32_C(1) << (BITS - 1 - k);
+	}
+	// Initial numbers m_k, odd and below 2^k, from a fixed stream
+	CounterRandom rng;
+	rng.seed(0, 0, CounterRandom::Purpose::Scramble, CounterRandom::SUB_MAX);
+	size_t dim = 1;
+	for (int degree = 1; dim < dimensions; degree++) {
+		if (degree >= BITS) {
+			throw runtime_error("Too many Sobol dimensions");
+		}
+		for (uint64_t poly = (UINT64_C(1) << degree) | 1; poly < UINT64_C(2) << degree && dim < dimensions; poly += 2) {
+			if (!IsPrimitive(poly, degree)) {
+				continue;
+			}
+			vector<uint32_t> m(BITS + 1);
+			for (int k = 1; k <= degree; k++) {
+				m[k] = (rng() & ((UINT32_C(1) << (k - 1)) - 1)) << 1 | 1;
+			}
+			// m_k = 2 a_1 m_{k-1} ^ 4 a_2 m_{k-2} ^ ... ^ 2^s m_{k-s} ^ m_{k-s}
+			for (int k = degree + 1; k <= BITS; k++) {
+				uint32_t v = m[k - degree] ^ m[k - degree] << degree;
+				for (int j = 1; j < degree; j++) {
+					if (poly >> (degree - j) & 1) {
+						v ^= m[k - j] << j;
+					}
+				}
+				m[k] = v;
+			}
+			for (int k = 1; k <= BITS; k++) {
+				directions[dim * BITS + k - 1] = m[k] << (BITS - k);
+			}
+			dim++;
+		}
+	}
+}
+
+
+QmcPoints::QmcPoints(size_t cards, unsigned replicates, uint64_t seed)
+	: cards(cards)
+	, replicateNum(replicates)
+	, seedValue(seed)
+	, sobol(cards * ROLLS_PER_CARD)
+	, scrambles(replicates * cards * ROLLS_PER_CARD) {
+	if (replicates == 0) {
+		throw invalid_argument("QMC needs at least one replicate");
+	}
+	CounterRandom rng;
+	for (unsigned r = 0; r < replicates; r++) {
+		for (size_t dim = 0; dim < sobol.dimensions(); dim++) {
+			rng.seed(seed, r, CounterRandom::Purpose::Scramble, static_cast<uint32_t>(dim));
+			scrambles[r * sobol.dimensions() + dim] = rng();
+		}
+	}
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include "configure.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "counterrandom.h"
+#include "util.h"
+
+
+// Sobol points as 32-bit fractions. Dimension 0 is the van der Corput
+// sequence, the others use primitive polynomials in increasing degree with
+// initial direction numbers from a fixed stream, which keeps every
+// one-dimensional projection a (0, 1)-sequence.
+class SobolSequence {
+public:
+	static constexpr int BITS = 32;
+
+	explicit SobolSequence(size_t dimensions = 0);
+
+	size_t dimensions() const {
+		return directions.size() / BITS;
+	}
+
+	// Point index (low 32 bits) of dimension dim
+	uint32_t point(uint64_t index, size_t dim) const {
+		const uint32_t * v = &directions[dim * BITS];
+		uint32_t x = 0;
+		for (auto i = static_cast<uint32_t>(index); i; i &= i - 1) {
+			x ^= v[countTrailingZeros64(i)];
+		}
+		return x;
+	}
+
+private:
+	// [dim * BITS + bit]
+	std::vector<uint32_t> directions;
+};
+
+
+// Randomized quasi-Monte Carlo points for skill activation rolls.
+// Ids are split round robin into independent replicates, replicate id % n
+// taking point id / n of its own Owen-scrambled Sobol sequence, so the
+// standard error can come from the spread of the replicate means.
+// Roll k of card c is dimension k * cards + c, so the first rolls of every
+// card get the best dimensions; later rolls aren't covered.
+class QmcPoints {
+public:
+	static constexpr unsigned ROLLS_PER_CARD = QMC_ROLLS_PER_CARD;
+
+	QmcPoints(size_t cards, unsigned replicates, uint64_t seed);
+
+	unsigned replicates() const {
+		return replicateNum;
+	}
+
+	uint64_t seed() const {
+		return seedValue;
+	}
+
+	bool covers(unsigned roll) const {
+		return roll < ROLLS_PER_CARD;
+	}
+
+	// Uniform 32-bit fraction for roll of card at point index of replicate,
+	// index = id / replicates() and replicate = id % replicates(); roll shall be covered
+	uint32_t draw(uint64_t index, unsigned replicate, size_t card, unsigned roll) const {
+		size_t dim = roll * cards + card;
+		uint32_t scramble = scrambles[replicate * sobol.dimensions() + dim];
+		return OwenScramble(sobol.point(index, dim), scramble);
+	}
+
+private:
+	// Hash-based nested uniform scramble (Burley 2020): a Laine-Karras
+	// permutation on the reversed bits, where each bit only depends on the
+	// bits above it in the fraction
+	static uint32_t OwenScramble(uint32_t x, uint32_t seed) {
+		x = ReverseBits(x);
+		x += seed;
+		x ^= x * UINT32_C(0x6c50b47c);
+		x ^= x * UINT32_C(0xb82f1e52);
+		x ^= x * UINT32_C(0xc7afe638);
+		x ^= x * UINT32_C(0x8d22f6e6);
+		return ReverseBits(x);
+	}
+
+	static uint32_t ReverseBits(uint32_t x) {
+		x = (x & UINT32_C(0x55555555)) << 1 | (x >> 1 & UINT32_C(0x55555555));
+		x = (x & UINT32_C(0x33333333)) << 2 | (x >> 2 & UINT32_C(0x33333333));
+		x = (x & UINT32_C(0x0f0f0f0f)) << 4 | (x >> 4 & UINT32_C(0x0f0f0f0f));
+		x = (x & UINT32_C(0x00ff00ff)) << 8 | (x >> 8 & UINT32_C(0x00ff00ff));
+		return x << 16 | x >> 16;
+	}
+
+	size_t cards;
+	unsigned replicateNum;
+	uint64_t seedValue;
+	SobolSequence sobol;
+	// [replicate * dimensions + dim]
+	std::vector<uint32_t> scrambles;
+};
+
@@ -16,6 +16,14 @@ rapidjson::Document ParseJsonFile(std::FILE * fp) {
 	return doc;
 }
 
+rapidjson::Document ParseJsonString(const std::string & str) {
+	rapidjson::Document doc;
+	if (doc.Parse(str.data(), str.size()).HasParseError()) {
+		throw JsonParseError("Invalid JSON format");
+	}
+	return doc;
+}
+
 
 const rapidjson::Value & GetJsonItem(const rapidjson::Value & obj, rapidjson::SizeType index) {
 	if (index >= obj.Size()) {
@@ -96,6 +104,18 @@ optional<double> TryGetJsonMemberDouble(const rapidjson::Value & obj, const char
 }
 
 
+optional<uint64_t> TryGetJsonMemberUint64(const rapidjson::Value & obj, const char * name) {
+	auto member = obj.FindMember(name);
+	if (member == obj.MemberEnd() || member->value.IsNull()) {
+		return nullopt;
+	}
+	if (!member->value.IsUint64()) {
+		throw JsonParseError("JSON: Invalid type: "s + name);
+	}
+	return member->value.GetUint64();
+}
+
+
 optional<const char *> TryGetJsonMemberString(const rapidjson::Value & obj, const char * name) {
 	auto member = obj.FindMember(name);
 	if (member == obj.MemberEnd() || member->value.IsNull()) {
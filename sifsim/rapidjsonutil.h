@@ -7,6 +7,7 @@
 #include <utility>
 #include "optional.h"
 #include <cstdio>
+#include <cstdint>
 
 
 class JsonParseError : public std::runtime_error {
@@ -16,6 +17,7 @@ public:
 };
 
 rapidjson::Document ParseJsonFile(std::FILE * fp);
+rapidjson::Document ParseJsonString(const std::string & str);
 
 const rapidjson::Value & GetJsonItem(const rapidjson::Value & obj, rapidjson::SizeType index);
 const rapidjson::Value & GetJsonMember(const rapidjson::Value & obj, const char * name);
@@ -31,4 +33,6 @@ double GetJsonItemDouble(const rapidjson::Value & obj, rapidjson::SizeType index
 double GetJsonMemberDouble(const rapidjson::Value & obj, const char * name);
 optional<double> TryGetJsonMemberDouble(const rapidjson::Value & obj, const char * name);
 
+optional<uint64_t> TryGetJsonMemberUint64(const rapidjson::Value & obj, const char * name);
+
 optional<const char *> TryGetJsonMemberString(const rapidjson::Value & obj, const char * name);
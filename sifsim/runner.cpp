@@ -0,0 +1,559 @@
+#include "runner.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <atomic>
+#include <array>
+#include <stdexcept>
+
+using namespace std;
+using namespace std::chrono;
+
+
+static steady_clock::time_point TimeAfter(steady_clock::time_point start, double seconds) {
+	// About 30 years, longer times wouldn't fit in steady_clock::duration
+	if (seconds < 1e9) {
+		return start + duration_cast<steady_clock::duration>(duration<double>(seconds));
+	} else {
+		return steady_clock::time_point::max();
+	}
+}
+
+
+void RunOptions::setTimeLimit(double seconds, steady_clock::time_point start) {
+	deadline = TimeAfter(start, seconds);
+}
+
+
+SimulationRunner::SimulationRunner(const LiveModel & model, WorkerPool & pool, LiveEngine::Type engine)
+	: pool(pool)
+	, cardNum(model.cards.size())
+	, lives(pool.size(), LiveEngine(model, engine))
+	, partials(pool.size())
+	, pairPartials(pool.size()) {
+}
+
+
+// Antithetic pairs never span two chunks or batches
+static_assert(SCHEDULER_CHUNK_ITERS % 2 == 0 && CONVERGENCE_BATCH_ITERS % 2 == 0,
+	"SCHEDULER_CHUNK_ITERS and CONVERGENCE_BATCH_ITERS shall be even");
+
+
+uint64_t SimulationRunner::run(uint64_t seed, uint64_t first, uint64_t last, ScoreStatistics & stats,
+	const MeanEstimators & estimators, steady_clock::time_point deadline) {
+	auto pairSums = estimators.pairSums;
+	auto controlVariates = estimators.controlVariates;
+	auto replicates = estimators.replicates;
+	auto weighted = estimators.weighted;
+	IterationScheduler scheduler(first, last, SCHEDULER_CHUNK_ITERS);
+	if (controlVariates) {
+		controlPartials.assign(pool.size(), *controlVariates);
+	}
+	if (replicates) {
+		replicatePartials.assign(pool.size(), *replicates);
+		auto replicateNum = static_cast<unsigned>(replicates->size());
+		if (!qmc || qmc->seed() != seed || qmc->replicates() != replicateNum) {
+			qmc = make_unique<QmcPoints>(cardNum, replicateNum, seed);
+		}
+	}
+	if (weighted) {
+		weightedPartials.resize(pool.size());
+	}
+	pool.run([&](unsigned worker) {
+		auto & live = lives[worker];
+		auto & partial = partials[worker];
+		auto & pairPartial = pairPartials[worker];
+		live.setAntithetic(pairSums != nullptr);
+		live.setQmc(replicates ? qmc.get() : nullptr);
+		live.setTilt(weighted ? estimators.tilt : 0);
+		live.setThreshold(estimators.threshold);
+		partial.clear();
+		pairPartial.clear();
+		if (controlVariates) {
+			controlPartials[worker].clear();
+		}
+		if (replicates) {
+			replicatePartials[worker].clear();
+		}
+		if (weighted) {
+			weightedPartials[worker].clear();
+		}
+		uint64_t chunkFirst, chunkLast;
+		bool started = false;
+		array<LiveResult, LiveEngine::LANES> results;
+		while ((!started || steady_clock::now() < deadline) && scheduler.next(chunkFirst, chunkLast)) {
+			started = true;
+			int64_t y = 0;
+			array<int64_t, LiveResult::COVARIATE_NUM> x = {};
+			for (uint64_t i = chunkFirst; i != chunkLast; ++i) {
+				// Lives are simulated LANES at a time
+				size_t lane = (i - chunkFirst) % LiveEngine::LANES;
+				if (!lane) {
+					live.simulate(i, static_cast<size_t>(min<uint64_t>(LiveEngine::LANES, chunkLast - i)), seed, results.data());
+				}
+				const auto & result = results[lane];
+				partial.add(result.score);
+				if (replicates) {
+					replicatePartials[worker].add(static_cast<unsigned>(i % replicates->size()), result.score);
+				}
+				if (weighted) {
+					weightedPartials[worker].add(result.score, exp(result.logWeight));
+				}
+				if (!pairSums && !controlVariates) {
+					continue;
+				}
+				// Antithetic pairs are summed, otherwise every id is a sample
+				y += result.score;
+				if (controlVariates) {
+					for (int k = 0; k < LiveResult::COVARIATE_NUM; k++) {
+						x[k] += result.covariates[k];
+					}
+				}
+				if (pairSums && !(i & 1)) {
+					continue;
+				}
+				if (pairSums) {
+					pairPartial.add(y);
+				}
+				if (controlVariates) {
+					controlPartials[worker].add(y, x.data());
+					x.fill(0);
+				}
+				y = 0;
+			}
+		}
+	});
+	for (const auto & partial : partials) {
+		stats.merge(partial);
+	}
+	if (pairSums) {
+		for (const auto & pairPartial : pairPartials) {
+			pairSums->merge(pairPartial);
+		}
+	}
+	if (controlVariates) {
+		for (const auto & controlPartial : controlPartials) {
+			controlVariates->merge(controlPartial);
+		}
+	}
+	if (replicates) {
+		for (const auto & replicatePartial : replicatePartials) {
+			replicates->merge(replicatePartial);
+		}
+	}
+	if (weighted) {
+		for (const auto & weightedPartial : weightedPartials) {
+			weighted->merge(weightedPartial);
+		}
+	}
+	return scheduler.issued();
+}
+
+
+// Convergence is judged on the exact histogram, so the stopping point is reproducible
+static bool IsConverged(const RunOptions & options, const ScoreStatistics & stats,
+	const MeanEstimators & estimators = {}) {
+	const auto & hist = stats.histogram();
+	uint64_t n = hist.count();
+	if (options.targetSe) {
+		if (n < 2 || !(MeanStandardError(stats, estimators) <= *options.targetSe)) {
+			return false;
+		}
+	}
+	if (options.targetCi) {
+		if (n < 10000) {
+			return false;
+		}
+		if (estimators.weighted) {
+			double q = estimators.tilt < 0 ? TAIL_FRACTION : 1 - TAIL_FRACTION;
+			int x = estimators.weighted->quantile(q);
+			auto ci = estimators.weighted->quantileInterval(q, Z_95);
+			return max(x - ci.first, ci.second - x) <= *options.targetCi;
+		}
+		int top = hist.nth(TopRank(n));
+		auto ci = hist.quantileInterval(static_cast<double>(TopRank(n)) / n, Z_95);
+		if (!(max(top - ci.first, ci.second - top) <= *options.targetCi)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+void SimulationRunner::run(const RunOptions & options, ScoreStatistics & stats, const MeanEstimators & estimators) {
+	bool hasTarget = options.targetSe || options.targetCi;
+	uint64_t total = options.last - options.first;
+	uint64_t batch = hasTarget ? CONVERGENCE_BATCH_ITERS : total;
+	auto nextCheckpoint = options.checkpoint
+		? TimeAfter(steady_clock::now(), options.checkpointInterval) : steady_clock::time_point::max();
+	uint64_t id = options.first + stats.count();
+	while (id < options.last) {
+		// Batches are counted from first, so a resumed run stops at the same point
+		uint64_t done = id - options.first;
+		if (hasTarget && done != 0 && done % batch == 0 && IsConverged(options, stats, estimators)) {
+			break;
+		}
+		uint64_t batchLast = options.first + min(done / batch * batch + batch, total);
+		id = run(options.seed, id, batchLast, stats, estimators, min(options.deadline, nextCheckpoint));
+		if (steady_clock::now() >= nextCheckpoint) {
+			options.checkpoint(stats);
+			nextCheckpoint = TimeAfter(steady_clock::now(), options.checkpointInterval);
+		}
+		if (steady_clock::now() >= options.deadline) {
+			break;
+		}
+	}
+	if (options.checkpoint) {
+		options.checkpoint(stats);
+	}
+}
+
+
+CompareRunner::CompareRunner(const vector<const LiveModel *> & models, WorkerPool & pool, LiveEngine::Type engine)
+	: pool(pool)
+	, liveNum(models.size())
+	, workers(pool.size()) {
+	bool shareJudgments = all_of(models.begin(), models.end(), [&](const LiveModel * model) {
+		return HitJudge::isShareable(*models[0], *model);
+	});
+	for (auto & worker : workers) {
+		for (const auto * model : models) {
+			worker.lives.emplace_back(*model, engine);
+		}
+		if (shareJudgments) {
+			worker.judge.emplace(*models[0]);
+			worker.judgments.emplace(*models[0]);
+		}
+		worker.scores.resize(liveNum);
+	}
+}
+
+
+uint64_t CompareRunner::run(uint64_t seed, uint64_t first, uint64_t last,
+	vector<ScoreStatistics> & stats, vector<PairedStatistics> & pairs,
+	steady_clock::time_point deadline) {
+	IterationScheduler scheduler(first, last, SCHEDULER_CHUNK_ITERS);
+	pool.run([&](unsigned index) {
+		auto & worker = workers[index];
+		worker.stats.assign(liveNum, ScoreStatistics());
+		worker.pairs.assign(liveNum * (liveNum - 1) / 2, PairedStatistics());
+		uint64_t chunkFirst, chunkLast;
+		bool started = false;
+		while ((!started || steady_clock::now() < deadline) && scheduler.next(chunkFirst, chunkLast)) {
+			started = true;
+			for (uint64_t id = chunkFirst; id != chunkLast; ++id) {
+				if (worker.judge) {
+					worker.judge->judge(id, seed, *worker.judgments);
+				}
+				for (size_t i = 0; i < liveNum; i++) {
+					worker.scores[i] = worker.judge
+						? worker.lives[i].simulate(id, seed, *worker.judgments).score
+						: worker.lives[i].simulate(id, seed).score;
+					worker.stats[i].add(worker.scores[i]);
+				}
+				auto itPair = worker.pairs.begin();
+				for (size_t i = 0; i < liveNum; i++) {
+					for (size_t j = i + 1; j < liveNum; j++) {
+						(itPair++)->add(worker.scores[i], worker.scores[j]);
+					}
+				}
+			}
+		}
+	});
+	stats.resize(liveNum);
+	pairs.resize(liveNum * (liveNum - 1) / 2);
+	for (const auto & worker : workers) {
+		for (size_t i = 0; i < liveNum; i++) {
+			stats[i].merge(worker.stats[i]);
+		}
+		for (size_t p = 0; p < pairs.size(); p++) {
+			pairs[p].merge(worker.pairs[p]);
+		}
+	}
+	return scheduler.issued();
+}
+
+
+void CompareRunner::run(const RunOptions & options, vector<ScoreStatistics> & stats, vector<PairedStatistics> & pairs) {
+	const auto isConverged = [&]() {
+		return all_of(pairs.begin(), pairs.end(), [&](const PairedStatistics & pair) {
+			return pair.count() >= 2 && pair.standardError() <= *options.targetSe;
+		});
+	};
+	uint64_t total = options.last - options.first;
+	uint64_t batch = options.targetSe ? CONVERGENCE_BATCH_ITERS : total;
+	uint64_t id = options.first;
+	while (id < options.last) {
+		uint64_t done = id - options.first;
+		if (options.targetSe && done != 0 && done % batch == 0 && isConverged()) {
+			break;
+		}
+		uint64_t batchLast = options.first + min(done / batch * batch + batch, total);
+		id = run(options.seed, id, batchLast, stats, pairs, options.deadline);
+		if (steady_clock::now() >= options.deadline) {
+			break;
+		}
+	}
+}
+
+
+SplittingRunner::SplittingRunner(const LiveModel & model, WorkerPool & pool, unsigned particles, unsigned stages)
+	: model(model)
+	, pool(pool)
+	, particles(particles) {
+	if (particles == 0 || stages == 0) {
+		throw invalid_argument("Splitting needs at least one particle and one stage");
+	}
+	uint64_t hitNum = 0;
+	for (const auto & hits : model.chartHits) {
+		hitNum += hits.size();
+	}
+	for (unsigned s = 1; s < stages; s++) {
+		uint64_t hit = hitNum * s / stages;
+		size_t k = 0;
+		while (hit >= model.chartHits[k].size()) {
+			hit -= model.chartHits[k++].size();
+		}
+		stops.emplace_back(k, static_cast<int>(hit));
+	}
+	for (unsigned i = 0; i < pool.size(); i++) {
+		workers.push_back(make_unique<Worker>(model));
+		auto & worker = *workers.back();
+		worker.states.resize(particles);
+		worker.nextStates.resize(particles);
+		worker.judgments.resize(particles, HitJudgments(model));
+		worker.nextJudgments.resize(particles, HitJudgments(model));
+		worker.levels.resize(particles);
+		worker.nextLevels.resize(particles);
+		worker.lastLevels.resize(particles);
+		worker.nextLastLevels.resize(particles);
+		worker.weights.resize(particles);
+	}
+}
+
+
+SplittingRunner::Result SplittingRunner::run(uint64_t seed, uint64_t first, uint64_t systems, int target, double tilt) {
+	vector<double> estimates(systems);
+	IterationScheduler scheduler(0, systems, 1);
+	pool.run([&](unsigned worker) {
+		uint64_t system, systemLast;
+		while (scheduler.next(system, systemLast)) {
+			estimates[system] = runSystem(*workers[worker], seed, first + system * particles, system, target, tilt);
+		}
+	});
+	Result result;
+	for (double p : estimates) {
+		result.probability += p;
+	}
+	result.probability /= systems;
+	if (systems >= 2) {
+		double sum = 0;
+		for (double p : estimates) {
+			sum += (p - result.probability) * (p - result.probability);
+		}
+		result.standardError = sqrt(sum / (systems - 1) / systems);
+	}
+	return result;
+}
+
+
+double SplittingRunner::runSystem(Worker & w, uint64_t seed, uint64_t first, uint64_t system, int target, double tilt) {
+	auto & live = w.live;
+	const auto runToStop = [&](size_t stage) {
+		if (stage < stops.size()) {
+			live.run(stops[stage].first, stops[stage].second);
+		} else {
+			live.run();
+		}
+	};
+	// The first lives are the same as plain simulations of their ids
+	for (unsigned j = 0; j < particles; j++) {
+		w.judge.judge(first + j, seed, w.judgments[j]);
+		live.start(first + j, seed, w.judgments[j]);
+		runToStop(0);
+		w.states[j] = live.state();
+		w.levels[j] = live.state().score;
+		w.lastLevels[j] = 0;
+	}
+	// Log of the product of the mean weights of every stage
+	double logScale = 0;
+	for (size_t s = 1; s <= stops.size(); s++) {
+		double maxLog = -INFINITY;
+		for (unsigned j = 0; j < particles; j++) {
+			maxLog = max(maxLog, tilt * (w.levels[j] - w.lastLevels[j]));
+		}
+		double weightSum = 0;
+		for (unsigned j = 0; j < particles; j++) {
+			w.weights[j] = exp(tilt * (w.levels[j] - w.lastLevels[j]) - maxLog);
+			weightSum += w.weights[j];
+		}
+		logScale += maxLog + log(weightSum / particles);
+
+		// Systematic resampling, particle j copies the one covering (j + u) / particles of the weights
+		CounterRandom rng;
+		rng.seed(seed, system, CounterRandom::Purpose::Resample, static_cast<uint32_t>(s));
+		double u = ldexp(rng() + 0.5, -32);
+		double cumulative = w.weights[0];
+		unsigned parent = 0;
+		uint64_t stageSeed = seed + s * UINT64_C(0x9e3779b97f4a7c15);
+		for (unsigned j = 0; j < particles; j++) {
+			double position = (j + u) / particles * weightSum;
+			while (cumulative < position && parent + 1 < particles) {
+				cumulative += w.weights[++parent];
+			}
+			w.nextJudgments[j] = w.judgments[parent];
+			// Builds simulating hit timings reject --splitting
+#if !SIMULATE_HIT_TIMING
+			w.judge.judge(first + j, stageSeed, w.fresh);
+			w.judge.splice(w.fresh, stops[s - 1].first, stops[s - 1].second, w.nextJudgments[j]);
+#endif
+			live.restore(w.states[parent]);
+			live.rejudge(w.nextJudgments[j]);
+			live.reseed(first + j, stageSeed);
+			runToStop(s);
+			w.nextStates[j] = live.state();
+			w.nextLevels[j] = live.state().score;
+			w.nextLastLevels[j] = w.levels[parent];
+		}
+		swap(w.states, w.nextStates);
+		swap(w.judgments, w.nextJudgments);
+		swap(w.levels, w.nextLevels);
+		swap(w.lastLevels, w.nextLastLevels);
+	}
+
+	// Undo the weights: the lives reaching target are weighted by e^(-tilt * score at the last point)
+	double maxLog = -INFINITY;
+	for (unsigned j = 0; j < particles; j++) {
+		if (static_cast<int>(w.levels[j]) >= target) {
+			maxLog = max(maxLog, -tilt * w.lastLevels[j]);
+		}
+	}
+	if (maxLog == -INFINITY) {
+		return 0;
+	}
+	double sum = 0;
+	for (unsigned j = 0; j < particles; j++) {
+		if (static_cast<int>(w.levels[j]) >= target) {
+			sum += exp(-tilt * w.lastLevels[j] - maxLog);
+		}
+	}
+	return exp(logScale + maxLog + log(sum / particles));
+}
+
+
+void BatchRunner::run(vector<Job> & jobs) {
+	// Jobs of one task run the same ids with the same seed and share the hit judgments
+	struct Task {
+		vector<size_t> jobs;
+		uint64_t first;
+		IterationScheduler scheduler;
+
+		Task(size_t job, uint64_t first, uint64_t last)
+			: jobs{ job }, first(first), scheduler(first, last, SCHEDULER_CHUNK_ITERS) {}
+	};
+
+	vector<uint64_t> next;
+	vector<unsigned char> done;
+	// Index of the first job whose judgments can be shared with each job
+	vector<size_t> judgmentGroups;
+	for (size_t i = 0; i < jobs.size(); i++) {
+		const auto & job = jobs[i];
+		next.push_back(job.options.first);
+		done.push_back(job.options.first >= job.options.last);
+		size_t group = i;
+		for (size_t j = 0; j < i; j++) {
+			if (judgmentGroups[j] == j && HitJudge::isShareable(*jobs[j].model, *job.model)) {
+				group = j;
+				break;
+			}
+		}
+		judgmentGroups.push_back(group);
+	}
+
+	for (;;) {
+		vector<unique_ptr<Task>> tasks;
+		for (size_t i = 0; i < jobs.size(); i++) {
+			if (done[i]) {
+				continue;
+			}
+			const auto & options = jobs[i].options;
+			uint64_t batch = options.targetSe || options.targetCi ? CONVERGENCE_BATCH_ITERS : options.last - next[i];
+			uint64_t last = next[i] + min(batch, options.last - next[i]);
+			auto itTask = find_if(tasks.begin(), tasks.end(), [&](const unique_ptr<Task> & task) {
+				const auto & other = jobs[task->jobs[0]].options;
+				return judgmentGroups[task->jobs[0]] == judgmentGroups[i]
+					&& task->first == next[i] && task->scheduler.end() == last
+					&& other.seed == options.seed && other.deadline == options.deadline;
+			});
+			if (itTask != tasks.end()) {
+				(*itTask)->jobs.push_back(i);
+			} else {
+				tasks.emplace_back(make_unique<Task>(i, next[i], last));
+			}
+		}
+		if (tasks.empty()) {
+			break;
+		}
+
+		// Workers go through the tasks in order. A task is left once it is out of
+		// ids, or out of time and someone has taken at least one chunk of it.
+		vector<vector<ScoreStatistics>> partials(pool.size(), vector<ScoreStatistics>(jobs.size()));
+		atomic<size_t> cursor{ 0 };
+		pool.run([&](unsigned worker) {
+			vector<LiveEngine> lives;
+			optional<HitJudge> judge;
+			optional<HitJudgments> judgments;
+			const Task * liveTask = nullptr;
+			size_t t = cursor.load(memory_order_relaxed);
+			uint64_t chunkFirst, chunkLast;
+			while (t < tasks.size()) {
+				auto & task = *tasks[t];
+				const auto & options = jobs[task.jobs[0]].options;
+				bool expired = task.scheduler.issued() != task.first
+					&& steady_clock::now() >= options.deadline;
+				if (expired || !task.scheduler.next(chunkFirst, chunkLast)) {
+					if (cursor.compare_exchange_strong(t, t + 1, memory_order_relaxed)) {
+						++t;
+					}
+					continue;
+				}
+				if (liveTask != &task) {
+					liveTask = &task;
+					lives.clear();
+					for (size_t i : task.jobs) {
+						lives.emplace_back(*jobs[i].model, jobs[i].engine);
+					}
+					if (task.jobs.size() > 1) {
+						judge.emplace(*jobs[task.jobs[0]].model);
+						judgments.emplace(*jobs[task.jobs[0]].model);
+					}
+				}
+				for (uint64_t id = chunkFirst; id != chunkLast; ++id) {
+					if (task.jobs.size() == 1) {
+						partials[worker][task.jobs[0]].add(lives[0].simulate(id, options.seed).score);
+						continue;
+					}
+					judge->judge(id, options.seed, *judgments);
+					for (size_t k = 0; k < task.jobs.size(); k++) {
+						partials[worker][task.jobs[k]].add(lives[k].simulate(id, options.seed, *judgments).score);
+					}
+				}
+			}
+		});
+
+		for (const auto & task : tasks) {
+			for (size_t i : task->jobs) {
+				auto & job = jobs[i];
+				for (const auto & workerPartials : partials) {
+					job.stats.merge(workerPartials[i]);
+				}
+				next[i] = task->scheduler.issued();
+				bool hasTarget = job.options.targetSe || job.options.targetCi;
+				done[i] = next[i] == job.options.last
+					|| next[i] != task->scheduler.end()
+					|| steady_clock::now() >= job.options.deadline
+					|| (hasTarget && IsConverged(job.options, job.stats));
+			}
+		}
+	}
+}
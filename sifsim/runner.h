@@ -0,0 +1,198 @@
+#pragma once
+#include "configure.h"
+
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <cstdint>
+#include "optional.h"
+#include "livemodel.h"
+#include "engine.h"
+#include "live.h"
+#include "judgment.h"
+#include "qmc.h"
+#include "scheduler.h"
+#include "statistics.h"
+
+
+// Ids to simulate and when to stop early
+struct RunOptions {
+	uint64_t seed = 0;
+	uint64_t first = 0;
+	uint64_t last = 0;
+	optional<double> targetSe;
+	optional<double> targetCi;
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+	// Called with the statistics so far every checkpointInterval seconds and at the end
+	std::function<void(const ScoreStatistics &)> checkpoint;
+	double checkpointInterval = CHECKPOINT_INTERVAL_SEC;
+
+	// Sets the deadline to start + seconds
+	void setTimeLimit(double seconds, std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now());
+};
+
+
+// Runs simulations of one live on a worker pool
+class SimulationRunner {
+public:
+	SimulationRunner(const LiveModel & model, WorkerPool & pool, LiveEngine::Type engine = LiveEngine::Type::Auto);
+	SimulationRunner(const SimulationRunner &) = delete;
+	SimulationRunner & operator=(const SimulationRunner &) = delete;
+
+	// Simulates ids [first, last) and merges the results into stats.
+	// After the deadline workers stop taking new chunks; each still finishes at
+	// least one. Returns the end of the simulated ids [first, end).
+	// With estimators.pairSums, ids 2k + 1 are antithetic to 2k and the score sum
+	// of each pair is merged into it; first and last shall be even.
+	// With estimators.controlVariates, the scores and LiveResult::covariates (of
+	// pairs if antithetic) are merged into it too.
+	// With estimators.replicates, activation rolls are drawn from QmcPoints
+	// with its number of replicates, which shall divide SCHEDULER_CHUNK_ITERS,
+	// first and last.
+	// With estimators.weighted, lives are simulated with estimators.tilt and
+	// the scores are merged into it with their likelihood ratios.
+	uint64_t run(uint64_t seed, uint64_t first, uint64_t last, ScoreStatistics & stats,
+		const MeanEstimators & estimators = {},
+		std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
+
+	// Simulates until all ids are done, the targets are met or time is up.
+	// Targets are checked every CONVERGENCE_BATCH_ITERS iterations.
+	// stats may already hold ids [first, first + stats.count()), e.g. from a
+	// checkpoint, and the run continues after them.
+	// targetSe applies to MeanStandardError(stats, estimators). With
+	// estimators.weighted, targetCi applies to the weighted quantile of the
+	// tail the tilt leans to, Low 0.1% if it is negative and 0.1% otherwise.
+	void run(const RunOptions & options, ScoreStatistics & stats, const MeanEstimators & estimators = {});
+
+private:
+	WorkerPool & pool;
+	size_t cardNum;
+	std::vector<LiveEngine> lives;
+	std::vector<ScoreStatistics> partials;
+	std::vector<ExactMoments> pairPartials;
+	std::vector<ControlVariates> controlPartials;
+	std::vector<ReplicateStatistics> replicatePartials;
+	std::vector<WeightedScores> weightedPartials;
+	std::unique_ptr<QmcPoints> qmc;
+};
+
+
+// Runs simulations of several lives with the same ids. Hit judgments and the
+// random streams of each card position are shared, so the differences between
+// the lives are much less noisy than the scores themselves.
+class CompareRunner {
+public:
+	CompareRunner(const std::vector<const LiveModel *> & models, WorkerPool & pool,
+		LiveEngine::Type engine = LiveEngine::Type::Auto);
+	CompareRunner(const CompareRunner &) = delete;
+	CompareRunner & operator=(const CompareRunner &) = delete;
+
+	size_t size() const {
+		return liveNum;
+	}
+
+	// Simulates ids [first, last) of every live and merges the results into
+	// stats[live] and pairs, which has one entry per pair (i, j), i < j, ordered
+	// by i then j. Returns the end of the simulated ids like SimulationRunner.
+	uint64_t run(uint64_t seed, uint64_t first, uint64_t last,
+		std::vector<ScoreStatistics> & stats, std::vector<PairedStatistics> & pairs,
+		std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
+
+	// Simulates until all ids are done, the standard error of every pair's
+	// difference meets targetSe or time is up. targetCi and checkpoints are not supported.
+	void run(const RunOptions & options, std::vector<ScoreStatistics> & stats, std::vector<PairedStatistics> & pairs);
+
+private:
+	struct Worker {
+		std::vector<LiveEngine> lives;
+		// Set if every live can share the first one's hit judgments
+		optional<HitJudge> judge;
+		optional<HitJudgments> judgments;
+		std::vector<int> scores;
+		std::vector<ScoreStatistics> stats;
+		std::vector<PairedStatistics> pairs;
+	};
+
+	WorkerPool & pool;
+	size_t liveNum;
+	std::vector<Worker> workers;
+};
+
+
+// Estimates the chance of a score of at least target, which may be tiny, by
+// splitting lives at stages - 1 points spread evenly over the hits. Each system
+// of particles lives is a particle filter (Del Moral & Garnier 2005): at every
+// point the lives are resampled with weights e^(tilt * score gained since the
+// last point), so lives on the way to high scores are copied, and every copy
+// continues with fresh skill activations and judgments of the remaining hits.
+// The final estimate undoes the weights, so each system is unbiased and the
+// standard error comes from the spread of the systems. Not available when hit
+// timings are simulated.
+class SplittingRunner {
+public:
+	struct Result {
+		double probability = 0;
+		double standardError = 0;
+	};
+
+	SplittingRunner(const LiveModel & model, WorkerPool & pool,
+		unsigned particles = SPLITTING_PARTICLES, unsigned stages = SPLITTING_STAGES);
+	SplittingRunner(const SplittingRunner &) = delete;
+	SplittingRunner & operator=(const SplittingRunner &) = delete;
+
+	// Runs systems [0, systems), system k starting from ids first + k * particles.
+	// tilt >= 0 leans the lives to high scores, about (target - mean) / variance
+	// of the score makes target a typical result.
+	Result run(uint64_t seed, uint64_t first, uint64_t systems, int target, double tilt);
+
+private:
+	struct Worker {
+		explicit Worker(const LiveModel & model) : live(model), judge(model), fresh(model) {}
+
+		Live live;
+		HitJudge judge;
+		HitJudgments fresh;
+		// Per particle, and the next generation
+		std::vector<LiveState> states, nextStates;
+		std::vector<HitJudgments> judgments, nextJudgments;
+		// Score at the last and the previous point
+		std::vector<double> levels, nextLevels;
+		std::vector<double> lastLevels, nextLastLevels;
+		std::vector<double> weights;
+	};
+
+	double runSystem(Worker & worker, uint64_t seed, uint64_t first, uint64_t system, int target, double tilt);
+
+	const LiveModel & model;
+	WorkerPool & pool;
+	unsigned particles;
+	// Chart and hit of each splitting point
+	std::vector<std::pair<size_t, int>> stops;
+	std::vector<std::unique_ptr<Worker>> workers;
+};
+
+
+// Runs simulations of many lives together on one worker pool.
+// Jobs advance in rounds of one convergence batch each, so every job stops
+// where it would if it ran alone.
+class BatchRunner {
+public:
+	struct Job {
+		const LiveModel * model;
+		RunOptions options;
+		ScoreStatistics stats;
+		LiveEngine::Type engine = LiveEngine::Type::Auto;
+	};
+
+	explicit BatchRunner(WorkerPool & pool) : pool(pool) {}
+	BatchRunner(const BatchRunner &) = delete;
+	BatchRunner & operator=(const BatchRunner &) = delete;
+
+	// Results are merged into each job's stats
+	void run(std::vector<Job> & jobs);
+
+private:
+	WorkerPool & pool;
+};
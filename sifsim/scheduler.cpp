@@ -0,0 +1,79 @@
+#include "scheduler.h"
+#include <utility>
+
+using namespace std;
+
+
+WorkerPool::WorkerPool(unsigned threads) {
+	if (threads == 0) {
+		threads = 1;
+	}
+	workers.reserve(threads - 1);
+	for (unsigned i = 1; i < threads; i++) {
+		workers.emplace_back(&WorkerPool::workerMain, this, i);
+	}
+}
+
+
+WorkerPool::~WorkerPool() {
+	{
+		lock_guard<mutex> lock(mtx);
+		quit = true;
+	}
+	startCond.notify_all();
+	for (auto & t : workers) {
+		t.join();
+	}
+}
+
+
+void WorkerPool::run(const function<void(unsigned)> & func) {
+	{
+		lock_guard<mutex> lock(mtx);
+		task = &func;
+		pending = static_cast<unsigned>(workers.size());
+		error = nullptr;
+		++generation;
+	}
+	startCond.notify_all();
+	runTask(0);
+	unique_lock<mutex> lock(mtx);
+	doneCond.wait(lock, [this] { return pending == 0; });
+	task = nullptr;
+	if (error) {
+		rethrow_exception(exchange(error, nullptr));
+	}
+}
+
+
+void WorkerPool::workerMain(unsigned index) {
+	uint64_t seen = 0;
+	for (;;) {
+		{
+			unique_lock<mutex> lock(mtx);
+			startCond.wait(lock, [&] { return quit || generation != seen; });
+			if (quit) {
+				return;
+			}
+			seen = generation;
+		}
+		runTask(index);
+		{
+			lock_guard<mutex> lock(mtx);
+			--pending;
+		}
+		doneCond.notify_one();
+	}
+}
+
+
+void WorkerPool::runTask(unsigned index) {
+	try {
+		(*task)(index);
+	} catch (...) {
+		lock_guard<mutex> lock(mtx);
+		if (!error) {
+			error = current_exception();
+		}
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include "configure.h"
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+
+
+// Hands out iteration ids [first, last) to worker threads in small chunks.
+// Fast threads simply take more chunks, so a slow thread only delays the run by
+// one chunk. Every iteration is seeded by its id, so results don't depend on
+// which thread runs which chunk.
+class IterationScheduler {
+public:
+	IterationScheduler(uint64_t first, uint64_t last, uint64_t chunkSize)
+		: nextId(first), last(last), chunkSize(std::max<uint64_t>(chunkSize, 1)) {}
+	IterationScheduler(const IterationScheduler &) = delete;
+	IterationScheduler & operator=(const IterationScheduler &) = delete;
+
+	// Returns false if no iteration is left
+	bool next(uint64_t & chunkFirst, uint64_t & chunkLast) {
+		uint64_t id = nextId.load(std::memory_order_relaxed);
+		do {
+			if (id >= last) {
+				return false;
+			}
+			chunkLast = id + std::min(chunkSize, last - id);
+		} while (!nextId.compare_exchange_weak(id, chunkLast, std::memory_order_relaxed));
+		chunkFirst = id;
+		return true;
+	}
+
+	// End of the ids handed out so far. Once every taken chunk is finished,
+	// the completed ids are exactly [first, issued()).
+	uint64_t issued() const {
+		return nextId.load(std::memory_order_relaxed);
+	}
+
+	uint64_t end() const {
+		return last;
+	}
+
+private:
+	std::atomic<uint64_t> nextId;
+	uint64_t last;
+	uint64_t chunkSize;
+};
+
+
+// Persistent worker threads. The calling thread works as worker 0.
+class WorkerPool {
+public:
+	explicit WorkerPool(unsigned threads);
+	~WorkerPool();
+	WorkerPool(const WorkerPool &) = delete;
+	WorkerPool & operator=(const WorkerPool &) = delete;
+
+	unsigned size() const {
+		return static_cast<unsigned>(workers.size()) + 1;
+	}
+
+	// Runs func(workerIndex) on every worker and waits for all of them.
+	// The first exception thrown by a worker is rethrown.
+	void run(const std::function<void(unsigned)> & func);
+
+private:
+	void workerMain(unsigned index);
+	void runTask(unsigned index);
+
+	std::vector<std::thread> workers;
+	std::mutex mtx;
+	std::condition_variable startCond;
+	std::condition_variable doneCond;
+	const std::function<void(unsigned)> * task = nullptr;
+	uint64_t generation = 0;
+	unsigned pending = 0;
+	bool quit = false;
+	std::exception_ptr error;
+};
@@ -0,0 +1,215 @@
+#include "scorebound.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+
+static const Skill::LevelData & CurrentLevel(const Skill & skill) {
+	return skill.levels[skill.level - 1];
+}
+
+
+static bool HasEffect(const LiveModel & model, Skill::Effect effect) {
+	return any_of(model.cards.begin(), model.cards.end(), [&](const Card & card) {
+		return card.skill.valid && card.skill.effect == effect;
+	});
+}
+
+
+// Largest value of an effect a card can have, a mimic may copy any skill of the unit
+static double MaxEffectValue(const LiveModel & model, const Card & card, Skill::Effect effect, double least) {
+	const auto & skill = card.skill;
+	if (!skill.valid) {
+		return least;
+	}
+	if (skill.effect == effect) {
+		return max(CurrentLevel(skill).effectValue, least);
+	}
+	double value = least;
+	if (skill.effect == Skill::Effect::Mimic) {
+		for (const auto & other : model.cards) {
+			if (other.skill.valid && other.skill.effect == effect) {
+				value = max(CurrentLevel(other.skill).effectValue, value);
+			}
+		}
+	}
+	return value;
+}
+
+
+ScoreBound::ScoreBound(const LiveModel & model) {
+	const auto & cards = model.cards;
+
+	// Status with every buff, sync and judge SIS on at once
+	vector<double> maxStatuses;
+	for (const auto & card : cards) {
+		maxStatuses.push_back(card.status);
+	}
+	for (const auto & card : cards) {
+		if (!card.skill.valid || card.skill.effect != Skill::Effect::GainStatus) {
+			continue;
+		}
+		for (int i : card.skill.effectTargets) {
+			maxStatuses[i] = max(cards[i].status * CurrentLevel(card.skill).effectValue, maxStatuses[i]);
+		}
+	}
+	double maxStatus = model.unitStatus;
+	for (size_t i = 0; i < cards.size(); i++) {
+		maxStatus += maxStatuses[i] - cards[i].status;
+	}
+	bool canSync = HasEffect(model, Skill::Effect::SyncStatus);
+	double maxSyncStatus = maxStatuses.empty() ? 0 : *max_element(maxStatuses.begin(), maxStatuses.end());
+	for (const auto & card : cards) {
+		if (card.skill.valid && canSync
+			&& (card.skill.effect == Skill::Effect::SyncStatus || card.skill.effect == Skill::Effect::Mimic)) {
+			maxStatus += max(maxSyncStatus - card.status, 0.);
+		}
+	}
+	if (HasEffect(model, Skill::Effect::GreatToPerfect) || HasEffect(model, Skill::Effect::GoodToPerfect)) {
+		maxStatus += max(model.judgeSisStatus, 0.);
+	}
+	// Live sums the changes in another order
+	maxStatus *= 1 + 1e-9;
+
+	// Every card holds at most one perfect bonus at a time, Live adds them up
+	double maxBonusRate = 1;
+	double maxBonusFixed = 0;
+	for (const auto & card : cards) {
+		maxBonusRate += MaxEffectValue(model, card, Skill::Effect::PerfectBonusRatio, 0);
+		maxBonusFixed += MaxEffectValue(model, card, Skill::Effect::PerfectBonusFixedValue, 0);
+	}
+	// Notes only score with the combo they are hit at, which never breaks
+	const auto maxNoteScore = [&](int combo, const LiveModel::NoteMuls & noteMuls) {
+		auto itComboMul = find_if(LiveModel::COMBO_MUL.begin(), LiveModel::COMBO_MUL.end(),
+			[&](const pair<int, double> & comboMul) { return combo <= comboMul.first; });
+		// Same order of operations as Live::computeScore
+		return ceil((floor(noteMuls.apply(maxStatus * 1.25 * itComboMul->second * maxBonusRate, true) / 100.)
+			+ maxBonusFixed) * model.liveScoreRate);
+	};
+
+	// ScorePlus activations: at most one per trigger, plus one already queued
+	// and one at the start of each chart
+	vector<TriggeredSkill> noteSkills;
+	double scoreTriggerSum = 0;
+	double scoreTriggerRatio = 0;
+	for (const auto & card : cards) {
+		double value = MaxEffectValue(model, card, Skill::Effect::ScorePlus, 0);
+		if (value <= 0) {
+			continue;
+		}
+		double interval = CurrentLevel(card.skill).triggerValue;
+		switch (card.skill.trigger) {
+		case Skill::Trigger::None:
+			break;
+
+		case Skill::Trigger::Time:
+			timeSkills.push_back({ value, interval });
+			break;
+
+		case Skill::Trigger::NotesCount:
+		case Skill::Trigger::ComboCount:
+		case Skill::Trigger::PerfectCount:
+		case Skill::Trigger::StarPerfect:
+			noteSkills.push_back({ value, interval });
+			break;
+
+		case Skill::Trigger::Score:
+			scoreTriggerSum += 2 * value;
+			scoreTriggerRatio += interval > 0 ? value / interval : INFINITY;
+			break;
+
+		case Skill::Trigger::Chain:
+			return;
+		}
+	}
+	if (!(scoreTriggerRatio < 1)
+		|| any_of(timeSkills.begin(), timeSkills.end(), [](const TriggeredSkill & skill) { return !(skill.interval > 0); })
+		|| any_of(noteSkills.begin(), noteSkills.end(), [](const TriggeredSkill & skill) { return !(skill.interval > 0); })) {
+		return;
+	}
+	// A gain G has at most G / interval + 2 score triggered activations
+	scoreTriggerScale = 1 / (1 - scoreTriggerRatio);
+
+	size_t chartNum = model.charts.size();
+	// Scored hits before each chart, hold begins only decide the hold end
+	vector<int> chartCombos(chartNum + 1);
+	for (size_t k = 0; k < chartNum; k++) {
+		const auto & hits = model.chartHits[k];
+		chartCombos[k + 1] = chartCombos[k] + static_cast<int>(count_if(hits.begin(), hits.end(),
+			[](const LiveModel::Hit & hit) { return !hit.isHoldBegin; }));
+	}
+	bounds.resize(chartNum);
+	laterTimeBounds.assign(chartNum, 0);
+	double later = scoreTriggerSum;
+	double laterTime = 0;
+	for (size_t k = chartNum; k-- > 0; ) {
+		const auto & hits = model.chartHits[k];
+		const auto & noteMuls = model.chartNoteMuls[k];
+		int endCombo = chartCombos[k + 1];
+		// Scored hits and their note scores from each hit on
+		vector<int> scored(hits.size() + 1);
+		vector<double> noteBounds(hits.size() + 1);
+#if SIMULATE_HIT_TIMING
+		// Hits are sorted by judged time in each live, only their number is
+		// known; the last combos of the chart have the highest multipliers
+		// Every factor at its largest bounds every note, the rounding is monotonic
+		LiveModel::NoteMuls maxMuls{ 0, { 0, 0 }, 0, 0 };
+		for (const auto & muls : noteMuls) {
+			maxMuls.category = max(maxMuls.category, muls.category);
+			maxMuls.hold[1] = max({ maxMuls.hold[1], muls.hold[0], muls.hold[1] });
+			maxMuls.slide = max(maxMuls.slide, muls.slide);
+			maxMuls.attribute = max(maxMuls.attribute, muls.attribute);
+		}
+		int chartScored = endCombo - chartCombos[k];
+		vector<double> lastComboBounds(chartScored + 1);
+		for (int n = 1; n <= chartScored; n++) {
+			lastComboBounds[n] = lastComboBounds[n - 1] + maxNoteScore(endCombo - n + 1, maxMuls);
+		}
+		for (size_t i = 0; i < hits.size(); i++) {
+			scored[i] = min(chartScored, static_cast<int>(hits.size() - i));
+			noteBounds[i] = lastComboBounds[scored[i]];
+		}
+#else
+		for (size_t i = hits.size(); i-- > 0; ) {
+			const auto & hit = hits[i];
+			scored[i] = scored[i + 1] + !hit.isHoldBegin;
+			noteBounds[i] = noteBounds[i + 1];
+			if (!hit.isHoldBegin) {
+				noteBounds[i] += maxNoteScore(endCombo - scored[i + 1], noteMuls[hit.noteIndex]);
+			}
+		}
+#endif
+		auto & chartBounds = bounds[k];
+		chartBounds.resize(hits.size() + 1);
+		for (size_t i = 0; i <= hits.size(); i++) {
+			double bound = noteBounds[i];
+			for (const auto & skill : noteSkills) {
+				bound += skill.value * (floor(scored[i] / skill.interval) + 2);
+			}
+			chartBounds[i] = bound + later;
+		}
+		laterTimeBounds[k] = laterTime;
+		later = chartBounds[0];
+		for (const auto & skill : timeSkills) {
+			laterTime += skill.value * (floor(model.charts[k].lastNoteShowTime / skill.interval) + 2);
+		}
+	}
+	lastNoteShowTimes.resize(chartNum);
+	for (size_t k = 0; k < chartNum; k++) {
+		lastNoteShowTimes[k] = model.charts[k].lastNoteShowTime;
+	}
+}
+
+
+double ScoreBound::operator()(size_t chart, int hit, double time) const {
+	if (bounds.empty()) {
+		return INFINITY;
+	}
+	double bound = bounds[chart][hit] + laterTimeBounds[chart];
+	double remainingTime = max(lastNoteShowTimes[chart] - time, 0.);
+	for (const auto & skill : timeSkills) {
+		bound += skill.value * (floor(remainingTime / skill.interval) + 2);
+	}
+	return bound * scoreTriggerScale;
+}
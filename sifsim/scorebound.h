@@ -0,0 +1,41 @@
+#pragma once
+#include "configure.h"
+
+#include <vector>
+#include <cstddef>
+#include "livemodel.h"
+
+
+// Upper bound on the score a live can still gain from a point on, as if every
+// note were a perfect with every status and perfect bonus skill on, and every
+// ScorePlus skill activated at each trigger. It is loose but cheap, for
+// cutting lives short that can't reach a score anymore.
+class ScoreBound {
+public:
+	explicit ScoreBound(const LiveModel & model);
+
+	// Whether the bound is finite; chain triggered ScorePlus skills or score
+	// triggered ones outpacing the score they add aren't bounded
+	bool bounded() const {
+		return !bounds.empty();
+	}
+
+	// Gain after the events and hits before hit of chart at time are done
+	double operator()(size_t chart, int hit, double time) const;
+
+private:
+	struct TriggeredSkill {
+		double value;
+		double interval;
+	};
+
+	// [chart][hit]: notes and skills not triggered by time from the hit on,
+	// including later charts
+	std::vector<std::vector<double>> bounds;
+	std::vector<TriggeredSkill> timeSkills;
+	// Per chart, time skills in later charts
+	std::vector<double> laterTimeBounds;
+	std::vector<double> lastNoteShowTimes;
+	// Score triggered skills scale the rest by this
+	double scoreTriggerScale = 1;
+};
@@ -0,0 +1,254 @@
+#include "server.h"
+#include "cmdarg.h"
+#include "livemodel.h"
+#include "chartcache.h"
+#include "runner.h"
+#include "statistics.h"
+#include "rapidjsonutil.h"
+#include "rapidjson/writer.h"
+#include "rapidjson/stringbuffer.h"
+#include "util.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <cstdio>
+#include <iostream>
+#include <chrono>
+#include <limits>
+#include <cmath>
+
+using namespace std;
+using namespace std::chrono;
+using namespace std::literals;
+
+
+static optional<double> GetJobPositive(const rapidjson::Value & job, const char * name) {
+	auto d = TryGetJsonMemberDouble(job, name);
+	if (d && !(*d > 0)) {
+		throw JsonParseError("Invalid job: "s + name);
+	}
+	return d;
+}
+
+
+static RunOptions GetJobOptions(const rapidjson::Value & job, steady_clock::time_point start) {
+	RunOptions options;
+	options.seed = TryGetJsonMemberUint64(job, "seed").value_or(*g_cmdArg.seed);
+	options.first = TryGetJsonMemberUint64(job, "skip_iters").value_or(g_cmdArg.skipIters);
+	auto targetSe = GetJobPositive(job, "target_se");
+	auto targetCi = GetJobPositive(job, "target_ci");
+	auto timeLimit = GetJobPositive(job, "time_limit");
+	auto iters = TryGetJsonMemberUint64(job, "iters");
+	if (iters && *iters == 0) {
+		throw JsonParseError("Invalid job: iters");
+	}
+	if (!iters) {
+		// Like -n, iters is unlimited if the job has its own stop condition
+		iters = targetSe || targetCi || timeLimit ? numeric_limits<uint64_t>::max() : *g_cmdArg.iters;
+	}
+	options.last = options.first + min(*iters, numeric_limits<uint64_t>::max() - options.first);
+	options.targetSe = targetSe ? targetSe : g_cmdArg.targetSe;
+	options.targetCi = targetCi ? targetCi : g_cmdArg.targetCi;
+	if (!timeLimit) {
+		timeLimit = g_cmdArg.timeLimit;
+	}
+	if (timeLimit) {
+		options.setTimeLimit(*timeLimit, start);
+	}
+	return options;
+}
+
+
+static unique_ptr<LiveModel> LoadJobModel(const rapidjson::Value & job, ChartCache & chartCache) {
+	auto inputPath = TryGetJsonMemberString(job, "input_path");
+	if (inputPath) {
+		auto input = ParseJsonFile(CFileWrapper(*inputPath, "rb"));
+		return make_unique<LiveModel>(input, &chartCache);
+	}
+	return make_unique<LiveModel>(GetJsonMemberObject(job, "input"), &chartCache);
+}
+
+
+static void WriteJobId(rapidjson::Writer<rapidjson::StringBuffer> & writer, const rapidjson::Value & job) {
+	if (job.IsObject()) {
+		auto itId = job.FindMember("id");
+		if (itId != job.MemberEnd()) {
+			writer.Key("id");
+			itId->value.Accept(writer);
+		}
+	}
+}
+
+
+// Mean and SD come from the histogram, so they don't depend on the thread count
+static string FormatResult(const rapidjson::Value & job, const RunOptions & options,
+	const ScoreStatistics & stats, double seconds) {
+	rapidjson::StringBuffer buffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+	const auto & hist = stats.histogram();
+	uint64_t n = stats.count();
+	writer.StartObject();
+	WriteJobId(writer, job);
+	writer.Key("iters");
+	writer.Uint64(n);
+	writer.Key("avg");
+	writer.Double(hist.mean());
+	writer.Key("sd");
+	if (n >= 2) {
+		writer.Double(sqrt(hist.variance()));
+	} else {
+		writer.Null();
+	}
+	writer.Key("min");
+	writer.Int(stats.min());
+	writer.Key("max");
+	writer.Int(stats.max());
+	if (n >= 10000) {
+		writer.Key("top");
+		writer.Int(hist.nth(TopRank(n)));
+	}
+	if (options.targetSe && n >= 2) {
+		writer.Key("se");
+		writer.Double(sqrt(hist.variance() / n));
+	}
+	if (options.targetCi && n >= 10000) {
+		auto ci = hist.quantileInterval(static_cast<double>(TopRank(n)) / n, Z_95);
+		writer.Key("top_ci");
+		writer.StartArray();
+		writer.Int(ci.first);
+		writer.Int(ci.second);
+		writer.EndArray();
+	}
+	writer.Key("seconds");
+	writer.Double(seconds);
+	writer.EndObject();
+	return buffer.GetString();
+}
+
+
+static string FormatError(const rapidjson::Value & job, const char * what) {
+	rapidjson::StringBuffer buffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+	writer.StartObject();
+	WriteJobId(writer, job);
+	writer.Key("error");
+	writer.String(what);
+	writer.EndObject();
+	return buffer.GetString();
+}
+
+
+static bool IsBlank(const string & line) {
+	return line.find_first_not_of(" \t\r\n") == string::npos;
+}
+
+
+static string RunJob(const string & line, WorkerPool & pool, ChartCache & chartCache) {
+	rapidjson::Document job;
+	try {
+		auto start = steady_clock::now();
+		job = ParseJsonString(line);
+		if (!job.IsObject()) {
+			throw JsonParseError("Invalid job");
+		}
+		auto options = GetJobOptions(job, start);
+		auto model = LoadJobModel(job, chartCache);
+		SimulationRunner runner(*model, pool, g_cmdArg.engine);
+		ScoreStatistics stats;
+		runner.run(options, stats);
+		return FormatResult(job, options, stats, duration<double>(steady_clock::now() - start).count());
+	} catch (exception & e) {
+		return FormatError(job, e.what());
+	}
+}
+
+
+int RunServer(WorkerPool & pool) {
+	ChartCache chartCache(CHART_CACHE_SIZE);
+	string line;
+	while (getline(cin, line)) {
+		if (IsBlank(line)) {
+			continue;
+		}
+		cout << RunJob(line, pool, chartCache) << endl;
+	}
+	return 0;
+}
+
+
+static bool ReadLine(FILE * fp, string & line) {
+	line.clear();
+	char buf[0x1000];
+	while (fgets(buf, sizeof(buf), fp)) {
+		line += buf;
+		if (line.back() == '\n') {
+			return true;
+		}
+	}
+	return !line.empty();
+}
+
+
+int RunBatch(WorkerPool & pool, FILE * fp) {
+	struct PendingJob {
+		rapidjson::Document doc;
+		steady_clock::time_point start;
+		unique_ptr<LiveModel> model;
+		size_t runIndex;
+		string error;
+	};
+
+	ChartCache chartCache(CHART_CACHE_SIZE);
+	BatchRunner runner(pool);
+	string line;
+	bool eof = false;
+	while (!eof) {
+		vector<PendingJob> pending;
+		vector<BatchRunner::Job> jobs;
+		while (pending.size() < BATCH_JOB_WINDOW) {
+			if (!ReadLine(fp, line)) {
+				eof = true;
+				break;
+			}
+			if (IsBlank(line)) {
+				continue;
+			}
+			pending.emplace_back();
+			auto & job = pending.back();
+			try {
+				job.start = steady_clock::now();
+				job.doc = ParseJsonString(line);
+				if (!job.doc.IsObject()) {
+					throw JsonParseError("Invalid job");
+				}
+				auto options = GetJobOptions(job.doc, job.start);
+				auto model = LoadJobModel(job.doc, chartCache);
+				if (!LiveEngine::supports(*model, g_cmdArg.engine)) {
+					throw runtime_error("The simple engine doesn't support this unit");
+				}
+				job.model = move(model);
+				job.runIndex = jobs.size();
+				jobs.push_back({ job.model.get(), options, {}, g_cmdArg.engine });
+			} catch (exception & e) {
+				job.error = e.what();
+			}
+		}
+
+		runner.run(jobs);
+		for (const auto & job : pending) {
+			if (job.model) {
+				const auto & result = jobs[job.runIndex];
+				auto seconds = duration<double>(steady_clock::now() - job.start).count();
+				cout << FormatResult(job.doc, result.options, result.stats, seconds) << '\n';
+			} else {
+				cout << FormatError(job.doc, job.error.c_str()) << '\n';
+			}
+		}
+		cout.flush();
+	}
+	if (ferror(fp)) {
+		throw runtime_error("Cannot read batch input");
+	}
+	return 0;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "configure.h"
+
+#include <cstdio>
+#include "scheduler.h"
+
+
+// Simulation jobs are JSON objects, one per line:
+//   {"id": any, "input": {...} | "input_path": "...",
+//    "seed", "iters", "skip_iters", "target_se", "target_ci", "time_limit"}
+// Missing options default to the command line ones. Every job gets one line:
+//   {"id", "iters", "avg", "sd", "min", "max", "top", "se", "top_ci", "seconds"}
+// or {"id", "error"}. Charts given by path are parsed and processed once and
+// shared between jobs.
+
+// Serves jobs over standard input and output until end of input.
+// Jobs run one at a time, each answered as soon as it's done.
+int RunServer(WorkerPool & pool);
+
+// Runs all jobs in fp, up to BATCH_JOB_WINDOW at a time side by side on the pool.
+// Results are written in input order. A job's time limit counts from when it's
+// read, so it includes waiting for the jobs before it.
+int RunBatch(WorkerPool & pool, std::FILE * fp);
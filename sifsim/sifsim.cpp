@@ -2,6 +2,11 @@
 #include "nativechar.h"
 #include "cmdarg.h"
 #include "live.h"
+#include "runner.h"
+#include "server.h"
+#include "partial.h"
+#include "rapidjsonutil.h"
+#include "statistics.h"
 #include "util.h"
 #include <string>
 #include <iostream>
@@ -11,13 +16,26 @@
 #include <algorithm>
 #include <numeric>
 #include <thread>
-#include <future>
 #include <chrono>
+#include <limits>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <memory>
 
 using namespace std;
 using namespace std::chrono;
 
 
+// Whether the options ask for simulated lives rather than the score distribution.
+// -n, --seed and the stopping options only mean something to simulations.
+bool NeedsSimulations() {
+	return g_cmdArg.samplingOptions || g_cmdArg.antithetic || g_cmdArg.controlVariates || g_cmdArg.qmcReplicates || g_cmdArg.importanceTilt
+		|| g_cmdArg.splitting || g_cmdArg.threshold
+		|| g_cmdArg.server || g_cmdArg.batch || g_cmdArg.savePartial || g_cmdArg.checkpoint;
+}
+
+
 int ParseArg(int argc, char * argv[]) {
 	if (!parseCmdArg(g_cmdArg, argc, argv) || g_cmdArg.help) {
 		if (g_cmdArg.help) {
@@ -28,9 +46,103 @@ int ParseArg(int argc, char * argv[]) {
 		}
 	}
 	if (!g_cmdArg.iters) {
-		g_cmdArg.iters = SIFSIM_DEFAULT_ITERS;
+		if (g_cmdArg.targetSe || g_cmdArg.targetCi || g_cmdArg.timeLimit) {
+			// Run until converged or out of time, whole chunks keep antithetic pairs and QMC replicates even
+			g_cmdArg.iters = (numeric_limits<uint64_t>::max() - g_cmdArg.skipIters)
+				/ SCHEDULER_CHUNK_ITERS * SCHEDULER_CHUNK_ITERS;
+		} else {
+			g_cmdArg.iters = SIFSIM_DEFAULT_ITERS;
+		}
+	} else if (*g_cmdArg.iters > numeric_limits<uint64_t>::max() - g_cmdArg.skipIters) {
+		cerr << "sifsim: too many iterations\n";
+		return 1;
+	}
+	if (g_cmdArg.server && g_cmdArg.batch) {
+		cerr << "sifsim: --server and --batch can't be used together\n";
+		return 1;
+	}
+	if (g_cmdArg.antithetic) {
+		if (*g_cmdArg.iters % 2 != 0 || g_cmdArg.skipIters % 2 != 0) {
+			cerr << "sifsim: --antithetic requires even numbers of iterations and skipped iterations\n";
+			return 1;
+		}
+		if (g_cmdArg.server || g_cmdArg.batch || g_cmdArg.savePartial || g_cmdArg.checkpoint) {
+			cerr << "sifsim: --antithetic can't be used with --server, --batch, --save-partial or --checkpoint\n";
+			return 1;
+		}
+	}
+	if (g_cmdArg.controlVariates
+		&& (g_cmdArg.server || g_cmdArg.batch || g_cmdArg.savePartial || g_cmdArg.checkpoint)) {
+		cerr << "sifsim: --control-variates can't be used with --server, --batch, --save-partial or --checkpoint\n";
+		return 1;
+	}
+	if (g_cmdArg.qmcReplicates) {
+		int n = *g_cmdArg.qmcReplicates;
+		if (SCHEDULER_CHUNK_ITERS % n != 0 || CONVERGENCE_BATCH_ITERS % n != 0) {
+			cerr << "sifsim: --qmc shall divide " << SCHEDULER_CHUNK_ITERS << " and " << CONVERGENCE_BATCH_ITERS << "\n";
+			return 1;
+		}
+		if (*g_cmdArg.iters % n != 0 || g_cmdArg.skipIters % n != 0) {
+			cerr << "sifsim: --qmc requires numbers of iterations and skipped iterations divisible by it\n";
+			return 1;
+		}
+		if (g_cmdArg.antithetic || g_cmdArg.controlVariates
+			|| g_cmdArg.server || g_cmdArg.batch || g_cmdArg.savePartial || g_cmdArg.checkpoint) {
+			cerr << "sifsim: --qmc can't be used with --antithetic, --control-variates, --server, --batch, --save-partial or --checkpoint\n";
+			return 1;
+		}
+	}
+	if (g_cmdArg.importanceTilt && (g_cmdArg.antithetic || g_cmdArg.controlVariates || g_cmdArg.qmcReplicates
+		|| g_cmdArg.server || g_cmdArg.batch || g_cmdArg.savePartial || g_cmdArg.checkpoint)) {
+		cerr << "sifsim: --importance-tilt can't be used with --antithetic, --control-variates, --qmc, --server, --batch, --save-partial or --checkpoint\n";
+		return 1;
+	}
+	if (g_cmdArg.splitting) {
+#if SIMULATE_HIT_TIMING
+		// Hits are ordered by their judged times, so copies can't be judged afresh from a splitting point
+		cerr << "sifsim: --splitting isn't supported when hit timings are simulated\n";
+		return 1;
+#endif
+		if (g_cmdArg.antithetic || g_cmdArg.controlVariates || g_cmdArg.qmcReplicates || g_cmdArg.importanceTilt
+			|| g_cmdArg.server || g_cmdArg.batch || g_cmdArg.savePartial || g_cmdArg.checkpoint
+			|| g_cmdArg.targetSe || g_cmdArg.targetCi || g_cmdArg.timeLimit) {
+			cerr << "sifsim: --splitting can't be used with --antithetic, --control-variates, --qmc, --importance-tilt, "
+				"--server, --batch, --save-partial, --checkpoint or stopping options other than -n\n";
+			return 1;
+		}
+		if (g_cmdArg.engine == LiveEngine::Type::Simple || g_cmdArg.engine == LiveEngine::Type::Exact) {
+			cerr << "sifsim: --splitting requires the full engine\n";
+			return 1;
+		}
+		if (*g_cmdArg.iters < SPLITTING_PARTICLES) {
+			cerr << "sifsim: --splitting requires at least " << SPLITTING_PARTICLES << " iterations\n";
+			return 1;
+		}
+	}
+	if (g_cmdArg.threshold
+		&& (g_cmdArg.antithetic || g_cmdArg.controlVariates || g_cmdArg.qmcReplicates || g_cmdArg.importanceTilt
+			|| g_cmdArg.splitting || g_cmdArg.server || g_cmdArg.batch || g_cmdArg.savePartial || g_cmdArg.checkpoint
+			|| g_cmdArg.targetSe || g_cmdArg.targetCi)) {
+		cerr << "sifsim: --threshold can't be used with --antithetic, --control-variates, --qmc, --importance-tilt, "
+			"--splitting, --server, --batch, --save-partial, --checkpoint, --target-se or --target-ci\n";
+		return 1;
+	}
+	if (g_cmdArg.engine == LiveEngine::Type::Exact && NeedsSimulations()) {
+		cerr << "sifsim: --engine=exact can't be used with -n, --skip-iters, --seed, --target-se, --target-ci, --time-limit, "
+			"--antithetic, --control-variates, --qmc, --importance-tilt, --splitting, --threshold, --server, --batch, "
+			"--save-partial or --checkpoint\n";
+		return 1;
+	}
+	if (g_cmdArg.resume && !g_cmdArg.checkpoint) {
+		cerr << "sifsim: --resume requires --checkpoint\n";
+		return 1;
+	}
+	if (g_cmdArg.checkpoint && (g_cmdArg.server || g_cmdArg.batch)) {
+		cerr << "sifsim: --checkpoint can't be used with --server or --batch\n";
+		return 1;
 	}
-	if (!g_cmdArg.seed) {
+	// When resuming, the seed comes from the checkpoint
+	if (!g_cmdArg.seed && !(g_cmdArg.resume && fileExists(*g_cmdArg.checkpoint))) {
 #if NDEBUG
 		random_device rd;
 		g_cmdArg.seed = static_cast<uint64_t>(rd()) ^ static_cast<uint64_t>(rd()) << 32;
@@ -55,73 +167,354 @@ optional<const char *> GetInputFilename() {
 }
 
 
-template <class OutputIt>
-void RunSimulation(Live & live, uint64_t seed, uint64_t first, uint64_t last, OutputIt result) {
-	try {
-		for (uint64_t i = first; i != last; ++i) {
-			*result++ = live.simulate(i, seed);
+// Min and Max are of the samples, which share the support of the untilted distribution
+void PrintWeightedStatistics(const ScoreStatistics & stats, const WeightedScores & weighted) {
+	cout << fixed << setprecision(0);
+	cout << "Avg\t" << weighted.mean() << endl;
+	cout << "SD\t" << weighted.stddev() << endl;
+	cout << "Min\t" << stats.min() << endl;
+	cout << "Max\t" << stats.max() << endl;
+	cout << "0.1%\t" << weighted.quantile(1 - TAIL_FRACTION) << endl;
+	cout << "Low 0.1%\t" << weighted.quantile(TAIL_FRACTION) << endl;
+}
+
+
+// Moments of the histogram, the same whichever way the work was split
+void PrintStatistics(const ScoreStatistics & stats) {
+	const auto & hist = stats.histogram();
+	cout << fixed << setprecision(0);
+	cout << "Avg\t" << hist.mean() << endl;
+	cout << "SD\t" << sqrt(hist.variance()) << endl;
+	cout << "Min\t" << stats.min() << endl;
+	cout << "Max\t" << stats.max() << endl;
+	if (stats.count() >= 10000) {
+		cout << "0.1%\t" << stats.histogram().nth(TopRank(stats.count())) << endl;
+	}
+}
+
+
+// sifsim merge [--save-partial=FILE] PARTIAL...
+int MergeMain(int argc, char * argv[]) {
+	if (!parseCmdArg(g_cmdArg, argc, argv)) {
+		return 1;
+	}
+	if (g_cmdArg.help) {
+		printUsage();
+		return 0;
+	}
+	if (g_cmdArg.argumunts.empty()) {
+		cerr << "sifsim: merge requires partial result files\n";
+		return 1;
+	}
+	vector<PartialResult> partials;
+	for (const char * filename : g_cmdArg.argumunts) {
+		partials.push_back(LoadPartialResult(filename));
+	}
+	auto merged = MergePartialResults(move(partials));
+	clog << "Merged iterations [" << merged.first << ", " << merged.last << ") of seed " << merged.seed << "\n";
+	if (g_cmdArg.savePartial) {
+		SavePartialResult(*g_cmdArg.savePartial, merged);
+	}
+	PrintStatistics(merged.stats);
+	cout << "Iters\t" << merged.stats.count() << endl;
+	return 0;
+}
+
+
+// sifsim compare [OPTION]... FILE FILE...
+int CompareMain(int argc, char * argv[]) {
+	int parseRet = ParseArg(argc, argv);
+	if (parseRet != 0 || g_cmdArg.help) {
+		return parseRet;
+	}
+	if (g_cmdArg.argumunts.size() < 2) {
+		cerr << "sifsim: compare requires two or more input files\n";
+		return 1;
+	}
+	if (g_cmdArg.server || g_cmdArg.batch || g_cmdArg.savePartial || g_cmdArg.checkpoint || g_cmdArg.targetCi
+		|| g_cmdArg.antithetic || g_cmdArg.controlVariates || g_cmdArg.qmcReplicates || g_cmdArg.importanceTilt
+		|| g_cmdArg.splitting || g_cmdArg.threshold || g_cmdArg.engine == LiveEngine::Type::Exact) {
+		cerr << "sifsim: compare doesn't support --server, --batch, --save-partial, --checkpoint, --target-ci, --antithetic, --control-variates, --qmc, --importance-tilt, --splitting, --threshold or --engine=exact\n";
+		return 1;
+	}
+
+	auto start = steady_clock::now();
+	RunOptions options;
+	options.seed = *g_cmdArg.seed;
+	options.first = g_cmdArg.skipIters;
+	options.last = options.first + *g_cmdArg.iters;
+	options.targetSe = g_cmdArg.targetSe;
+	if (g_cmdArg.timeLimit) {
+		options.setTimeLimit(*g_cmdArg.timeLimit, start);
+	}
+
+	vector<unique_ptr<LiveModel>> models;
+	vector<const LiveModel *> modelPtrs;
+	for (size_t i = 0; i < g_cmdArg.argumunts.size(); i++) {
+		const char * filename = g_cmdArg.argumunts[i];
+		string input = readAll(strcmp(filename, "-") == 0 ? stdin : CFileWrapper(filename, "rb"));
+		models.push_back(make_unique<LiveModel>(ParseJsonString(input)));
+		modelPtrs.push_back(models.back().get());
+		clog << "Unit " << i + 1 << ": " << filename << "\n";
+	}
+
+	auto threads = g_cmdArg.threads.value_or(thread::hardware_concurrency());
+	WorkerPool pool(static_cast<unsigned>(threads));
+	CompareRunner runner(modelPtrs, pool, g_cmdArg.engine);
+	vector<ScoreStatistics> stats(models.size());
+	vector<PairedStatistics> pairs(models.size() * (models.size() - 1) / 2);
+	auto t0 = steady_clock::now();
+	runner.run(options, stats, pairs);
+	auto t1 = steady_clock::now();
+	clog << stats[0].count() << " simulations of each unit completed in "
+		<< duration<double>(t1 - t0).count() << " seconds\n";
+
+	cout << fixed << setprecision(0);
+	cout << "Unit\tAvg\tSD" << endl;
+	for (size_t i = 0; i < stats.size(); i++) {
+		const auto & hist = stats[i].histogram();
+		cout << i + 1 << "\t" << hist.mean() << "\t" << sqrt(hist.variance()) << endl;
+	}
+	// Differences of the same ids, A is the first unit of the pair
+	cout << "Pair\tDiff\tSE\tP(A>B)" << endl;
+	auto itPair = pairs.cbegin();
+	for (size_t i = 0; i < stats.size(); i++) {
+		for (size_t j = i + 1; j < stats.size(); j++, ++itPair) {
+			cout << i + 1 << "-" << j + 1 << "\t" << setprecision(1) << itPair->mean()
+				<< "\t" << itPair->standardError()
+				<< "\t" << setprecision(4) << itPair->winRate() << setprecision(0) << endl;
+		}
+	}
+	cout << "Iters\t" << stats[0].count() << endl;
+	return 0;
+}
+
+
+void PrintProbability(int target, double probability, double standardError, pair<double, double> ci, uint64_t iters) {
+	cout << defaultfloat << setprecision(4);
+	cout << "P(>=" << target << ")\t" << probability << endl;
+	cout << "SE\t" << standardError << endl;
+	cout << "95% CI\t" << ci.first << "\t" << ci.second << endl;
+	cout << "Iters\t" << iters << endl;
+}
+
+
+// Estimates the chance of at least target. A plain pilot run sets the tilt
+// that makes target a typical score if the scores were normal.
+int RunSplitting(const LiveModel & model, WorkerPool & pool, uint64_t seed, uint64_t first, uint64_t iters, int target) {
+	auto t0 = steady_clock::now();
+	ScoreStatistics pilot;
+	SimulationRunner(model, pool, g_cmdArg.engine).run(seed, first, first + SPLITTING_PILOT_ITERS, pilot);
+	double tilt = pilot.variance() > 0 ? max((target - pilot.mean()) / pilot.variance(), 0.) : 0;
+	uint64_t systems = iters / SPLITTING_PARTICLES;
+	SplittingRunner runner(model, pool);
+	auto result = runner.run(seed, first + SPLITTING_PILOT_ITERS, systems, target, tilt);
+	auto t1 = steady_clock::now();
+	clog << SPLITTING_PILOT_ITERS << " pilot simulations and " << systems << " particle systems completed in "
+		<< duration<double>(t1 - t0).count() << " seconds\n";
+
+	double lower = max(result.probability - Z_95 * result.standardError, 0.);
+	double upper = min(result.probability + Z_95 * result.standardError, 1.);
+	PrintProbability(target, result.probability, result.standardError, { lower, upper }, systems * SPLITTING_PARTICLES);
+	return 0;
+}
+
+
+// Estimates the chance of at least target with plain simulations, each cut
+// short once it has reached target or can't anymore
+int RunThreshold(const LiveModel & model, WorkerPool & pool, const RunOptions & options, int target) {
+	auto t0 = steady_clock::now();
+	ScoreStatistics stats;
+	MeanEstimators estimators;
+	estimators.threshold = target;
+	SimulationRunner(model, pool, g_cmdArg.engine).run(options, stats, estimators);
+	auto t1 = steady_clock::now();
+	clog << stats.count() << " simulations completed in "
+		<< duration<double>(t1 - t0).count() << " seconds\n";
+
+	uint64_t reached = 0;
+	stats.histogram().forEach([&](int score, uint64_t count) {
+		if (score >= target) {
+			reached += count;
 		}
-	} catch (exception & e) {
-		cerr << "Error: " << e.what() << endl;
-		quick_exit(1);
-	} catch (...) {
-		cerr << "An unknown error occured" << endl;
-		quick_exit(1);
+	});
+	double p = stats.count() ? static_cast<double>(reached) / stats.count() : 0;
+	double se = stats.count() ? sqrt(p * (1 - p) / stats.count()) : 0;
+	PrintProbability(target, p, se, WilsonInterval(reached, stats.count(), Z_95), stats.count());
+	return 0;
+}
+
+
+// Reports the exact score distribution instead of simulating
+int RunExact(const LiveModel & model) {
+	if (!LiveEngine::supports(model, LiveEngine::Type::Exact)) {
+		throw runtime_error("The exact engine doesn't support this unit");
 	}
+#if !SIMULATE_HIT_TIMING
+	auto t0 = steady_clock::now();
+	auto dist = SimpleLive(model).distribution();
+	auto t1 = steady_clock::now();
+	clog << "Score distribution computed in " << duration<double>(t1 - t0).count() << " seconds\n";
+
+	cout << fixed << setprecision(0);
+	cout << "Avg\t" << dist.mean() << endl;
+	cout << "SD\t" << dist.stddev() << endl;
+	// The extremes of every possible live, far wider than Min and Max of a sample
+	cout << "Min possible\t" << dist.min() << endl;
+	cout << "Max possible\t" << dist.max() << endl;
+	cout << "0.1%\t" << dist.quantile(1 - TAIL_FRACTION) << endl;
+#endif
+	return 0;
 }
 
 
 int Utf8Main(int argc, char * argv[]) try {
+	if (argc >= 2 && strcmp(argv[1], "merge") == 0) {
+		return MergeMain(argc - 1, argv + 1);
+	}
+	if (argc >= 2 && strcmp(argv[1], "compare") == 0) {
+		return CompareMain(argc - 1, argv + 1);
+	}
+
 	int parseRet = ParseArg(argc, argv);
 	if (parseRet != 0 || g_cmdArg.help) {
 		return parseRet;
 	}
 
-	auto inputFilename = GetInputFilename();
-	Live live(inputFilename ? CFileWrapper(*inputFilename, "rb") : stdin);
-	//double sum = 0.;
-	vector<int> results;
-	results.resize(*g_cmdArg.iters);
+	// The time limit covers loading, too
+	auto start = steady_clock::now();
+	RunOptions options;
+	if (g_cmdArg.seed) {
+		options.seed = *g_cmdArg.seed;
+	}
+	options.first = g_cmdArg.skipIters;
+	options.last = options.first + *g_cmdArg.iters;
+	options.targetSe = g_cmdArg.targetSe;
+	options.targetCi = g_cmdArg.targetCi;
+	if (g_cmdArg.timeLimit) {
+		options.setTimeLimit(*g_cmdArg.timeLimit, start);
+	}
 
 	auto threads = g_cmdArg.threads.value_or(thread::hardware_concurrency());
-	if (threads == 0) {
-		threads = 1;
+	WorkerPool pool(static_cast<unsigned>(threads));
+	if (g_cmdArg.server) {
+		return RunServer(pool);
 	}
-	// Last block in current thread
+
+	auto inputFilename = GetInputFilename();
+	if (g_cmdArg.batch) {
+		return RunBatch(pool, inputFilename ? CFileWrapper(*inputFilename, "rb") : stdin);
+	}
+	string input = readAll(inputFilename ? CFileWrapper(*inputFilename, "rb") : stdin);
+	const LiveModel model(ParseJsonString(input));
+	if (g_cmdArg.splitting) {
+		return RunSplitting(model, pool, options.seed, options.first, *g_cmdArg.iters, *g_cmdArg.splitting);
+	}
+	if (g_cmdArg.threshold) {
+		return RunThreshold(model, pool, options, *g_cmdArg.threshold);
+	}
+	if (g_cmdArg.engine == LiveEngine::Type::Exact || (g_cmdArg.engine == LiveEngine::Type::Auto
+		&& !NeedsSimulations() && LiveEngine::supports(model, LiveEngine::Type::Exact))) {
+		return RunExact(model);
+	}
+
+	uint64_t inputHash = hashFnv1a(input);
+	ScoreStatistics stats;
+	if (g_cmdArg.resume && fileExists(*g_cmdArg.checkpoint)) {
+		auto saved = LoadPartialResult(*g_cmdArg.checkpoint);
+		if (saved.inputHash != inputHash) {
+			throw runtime_error("Checkpoint was saved for a different input");
+		}
+		if (g_cmdArg.seed && *g_cmdArg.seed != saved.seed) {
+			throw runtime_error("Checkpoint was saved with a different seed");
+		}
+		if (saved.first != options.first || saved.last > options.last) {
+			throw runtime_error("Checkpoint doesn't match the iteration range");
+		}
+		options.seed = saved.seed;
+		stats = move(saved.stats);
+		clog << "Resuming after " << stats.count() << " simulations\n";
+	}
+	const auto makePartial = [&](const ScoreStatistics & s) {
+		PartialResult partial;
+		partial.seed = options.seed;
+		partial.inputHash = inputHash;
+		partial.first = options.first;
+		partial.last = options.first + s.count();
+		partial.stats = s;
+		return partial;
+	};
+	if (g_cmdArg.checkpoint) {
+		options.checkpoint = [&](const ScoreStatistics & s) {
+			SavePartialResult(*g_cmdArg.checkpoint, makePartial(s));
+		};
+		options.checkpointInterval = g_cmdArg.checkpointInterval.value_or(CHECKPOINT_INTERVAL_SEC);
+	}
+
 	auto t0 = steady_clock::now();
-	uint64_t block = *g_cmdArg.iters / threads;
-	vector<Live> lives(threads - 1, live);
-	vector<future<void>> futures;
-	uint64_t id = g_cmdArg.skipIters;
-	auto outit = results.begin();
-	for (auto & l : lives) {
-		futures.emplace_back(async(launch::async, RunSimulation<decltype(outit)>,
-			ref(l), *g_cmdArg.seed, id, id + block, outit));
-		id += block;
-		outit += block;
-	}
-	RunSimulation(live, *g_cmdArg.seed, id, g_cmdArg.skipIters + *g_cmdArg.iters, outit);
-	for (auto & f : futures) {
-		f.get();
+	uint64_t resumed = stats.count();
+	ExactMoments pairSums;
+	// Fitted to pair sums with antithetic sampling, whose covariate means are doubled
+	vector<double> covariateMeans;
+	for (double m : CovariateMeans(model)) {
+		covariateMeans.push_back(g_cmdArg.antithetic ? 2 * m : m);
+	}
+	ControlVariates controlVariates(covariateMeans);
+	ReplicateStatistics replicates(g_cmdArg.qmcReplicates.value_or(0));
+	WeightedScores weighted;
+	MeanEstimators estimators;
+	if (g_cmdArg.antithetic) {
+		estimators.pairSums = &pairSums;
+	}
+	if (g_cmdArg.controlVariates) {
+		estimators.controlVariates = &controlVariates;
+	}
+	if (g_cmdArg.qmcReplicates) {
+		estimators.replicates = &replicates;
+	}
+	if (g_cmdArg.importanceTilt) {
+		estimators.weighted = &weighted;
+		estimators.tilt = *g_cmdArg.importanceTilt;
 	}
+	SimulationRunner runner(model, pool, g_cmdArg.engine);
+	runner.run(options, stats, estimators);
 	auto t1 = steady_clock::now();
-	clog << *g_cmdArg.iters << " simulations completed in "
+	clog << stats.count() - resumed << " simulations completed in "
 		<< duration<double>(t1 - t0).count() << " seconds\n";
 
-	double avg = accumulate(results.begin(), results.end(), 0.) / results.size();
-	double sd = sqrt(accumulate(results.begin(), results.end(), 0., [avg](double s, double x) {
-		return s + (x - avg) * (x - avg);
-	}) / (results.size() - 1));
-	cout << fixed << setprecision(0);
-	cout << "Avg\t" << avg << endl;
-	cout << "SD\t" << sd << endl;
-	auto m = minmax_element(results.begin(), results.end());
-	cout << "Min\t" << *m.first << endl;
-	cout << "Max\t" << *m.second << endl;
-	if (*g_cmdArg.iters >= 10000) {
-		auto nth = results.end() - *g_cmdArg.iters / 1000;
-		nth_element(results.begin(), nth, results.end());
-		cout << "0.1%\t" << *nth << endl;
+	if (g_cmdArg.savePartial) {
+		SavePartialResult(*g_cmdArg.savePartial, makePartial(stats));
+	}
+
+	if (estimators.weighted) {
+		PrintWeightedStatistics(stats, weighted);
+	} else {
+		PrintStatistics(stats);
+	}
+	bool hasEstimator = estimators.pairSums || estimators.controlVariates || estimators.replicates || estimators.weighted;
+	if (options.targetSe || options.targetCi || g_cmdArg.timeLimit || hasEstimator) {
+		const auto & hist = stats.histogram();
+		cout << "Iters\t" << stats.count() << endl;
+		if (options.targetSe || hasEstimator) {
+			auto uncorrected = estimators;
+			uncorrected.controlVariates = nullptr;
+			cout << "SE\t" << setprecision(1)
+				<< MeanStandardError(stats, uncorrected) << setprecision(0) << endl;
+		}
+		if (estimators.controlVariates) {
+			cout << "CV Avg\t" << setprecision(1) << controlVariates.mean() / (g_cmdArg.antithetic ? 2 : 1) << endl;
+			cout << "CV SE\t" << MeanStandardError(stats, estimators) << setprecision(0) << endl;
+		}
+		if (estimators.weighted) {
+			auto top = weighted.quantileInterval(1 - TAIL_FRACTION, Z_95);
+			auto low = weighted.quantileInterval(TAIL_FRACTION, Z_95);
+			cout << "0.1% CI\t" << top.first << "\t" << top.second << endl;
+			cout << "Low 0.1% CI\t" << low.first << "\t" << low.second << endl;
+			cout << "ESS\t" << weighted.effectiveCount() << endl;
+		} else if (options.targetCi && stats.count() >= 10000) {
+			auto ci = hist.quantileInterval(static_cast<double>(TopRank(stats.count())) / stats.count(), Z_95);
+			cout << "0.1% CI\t" << ci.first << "\t" << ci.second << endl;
+		}
 	}
 	return 0;
 } catch (exception & e) {
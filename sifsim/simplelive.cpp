@@ -0,0 +1,576 @@
+#include "configure.h"
+#if !SIMULATE_HIT_TIMING
+#include "simplelive.h"
+#include "util.h"
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+#include <tuple>
+#include <cassert>
+
+using namespace std;
+
+
+bool SimpleLive::supports(const LiveModel & model) {
+#if FORCE_SKILL_FRAME_DELAY
+	return false;
+#else
+	for (const auto & card : model.cards) {
+		const auto & skill = card.skill;
+		if (!skill.valid) {
+			continue;
+		}
+		bool isScorePlus = skill.effect == Skill::Effect::ScorePlus && skill.discharge == Skill::Discharge::Immediate;
+		bool isBonus = skill.effect == Skill::Effect::PerfectBonusRatio && skill.discharge == Skill::Discharge::Duration;
+		if (!isScorePlus && !isBonus) {
+			return false;
+		}
+		switch (skill.trigger) {
+		case Skill::Trigger::None:
+		case Skill::Trigger::Time:
+		case Skill::Trigger::NotesCount:
+		case Skill::Trigger::ComboCount:
+		case Skill::Trigger::PerfectCount:
+		case Skill::Trigger::StarPerfect:
+			break;
+		default:
+			return false;
+		}
+		const auto & level = skill.levels[skill.level - 1];
+		if (skill.trigger != Skill::Trigger::None && level.triggerValue <= 0) {
+			return false;
+		}
+		// Scores are summed in a different order, which is exact for integers only
+		if (isScorePlus && (!(fabs(level.effectValue) < 1e9) || level.effectValue != floor(level.effectValue))) {
+			return false;
+		}
+		// A bonus ending when it starts would be popped among the events of that time
+		if (isBonus && !(level.dischargeTime > 0)) {
+			return false;
+		}
+	}
+	return true;
+#endif
+}
+
+
+bool SimpleLive::supportsDistribution(const LiveModel & model) {
+	if (!supports(model)) {
+		return false;
+	}
+	return none_of(model.cards.begin(), model.cards.end(), [](const Card & card) {
+		return card.skill.valid && (card.skill.trigger == Skill::Trigger::PerfectCount
+			|| card.skill.trigger == Skill::Trigger::StarPerfect
+			|| card.skill.effect == Skill::Effect::PerfectBonusRatio);
+	});
+}
+
+
+SimpleLive::SimpleLive(const LiveModel & model) : model(model), judge(model), ownJudgments(model) {
+	for (unsigned c = 0; c < model.cards.size(); c++) {
+		const auto & skill = model.cards[c].skill;
+		SkillData data{};
+		if (skill.valid) {
+			const auto & level = skill.levels[skill.level - 1];
+			data.effectValue = level.effectValue;
+			data.activationThreshold = level.activationRate * model.liveActivationRate;
+			data.activationPercent = ActivationPercent(data.activationThreshold);
+			data.triggerValue = level.triggerValue;
+			data.isPerfectTrigger = skill.trigger == Skill::Trigger::PerfectCount
+				|| skill.trigger == Skill::Trigger::StarPerfect;
+			data.isStarPerfect = skill.trigger == Skill::Trigger::StarPerfect;
+			data.isBonus = skill.effect == Skill::Effect::PerfectBonusRatio;
+			data.dischargeTime = level.dischargeTime;
+			(data.isBonus ? bonusCards : scorePlusCards).push_back(c);
+		}
+		skills.push_back(data);
+	}
+	skillOrder.resize(model.cards.size());
+	cardLogWeights.resize(model.cards.size());
+	laneEvents.resize(scorePlusCards.size());
+
+	int combo = 0;
+	for (size_t k = 0; k < model.charts.size(); k++) {
+		const auto & hits = model.chartHits[k];
+		timeGroupEnds.emplace_back(hits.size());
+		for (size_t i = hits.size(); i-- > 0;) {
+			bool sameTime = i + 1 < hits.size() && hits[i + 1].time == hits[i].time;
+			timeGroupEnds[k][i] = sameTime ? timeGroupEnds[k][i + 1] : static_cast<int>(i + 1);
+		}
+		scoredBefore.emplace_back(1, 0);
+		for (const auto & hit : hits) {
+			scoredBefore[k].push_back(scoredBefore[k].back() + !hit.isHoldBegin);
+		}
+		comboBefore.push_back(combo);
+		combo += scoredBefore[k].back();
+	}
+
+	initScores();
+	countFixedEvents();
+}
+
+
+// Without skills changing status a note score only depends on its own outcome
+// and the perfect bonus, computed here without one
+void SimpleLive::initScores() {
+	int combo = 0;
+	auto itComboMul = LiveModel::COMBO_MUL.cbegin();
+	for (size_t k = 0; k < model.charts.size(); k++) {
+		const auto & hits = model.chartHits[k];
+		auto & scores = hitScores.emplace_back(hits.size(), array<double, 4>{});
+		auto & comboMuls = hitComboMuls.emplace_back(hits.size());
+		for (int i = 0; i < static_cast<int>(hits.size()); i++) {
+			if (hits[i].isHoldBegin) {
+				continue;
+			}
+			++combo;
+			if (combo > itComboMul->first) {
+				++itComboMul;
+			}
+			comboMuls[i] = itComboMul->second;
+			for (int j = 0; j < 4; j++) {
+				scores[i][j] = hitScore(k, i, j >> 1, j & 1, 1);
+			}
+			allPerfectScore += scores[i][3];
+		}
+	}
+}
+
+
+// Every event of an immediate skill sets the next trigger, and time, note and
+// combo triggers don't depend on the note outcomes
+void SimpleLive::countFixedEvents() {
+	for (auto c : scorePlusCards) {
+		if (skills[c].isPerfectTrigger) {
+			continue;
+		}
+		TriggerPoint point{};
+		int triggerValue = 0;
+		while (nextTrigger(c, point, triggerValue)) {
+			skills[c].fixedEvents++;
+		}
+	}
+}
+
+
+// Replays skillSetNextTrigger of Live at point and moves point to the event it
+// queues, or returns false if the card triggers no more. triggerValue is
+// card.nextTrigger of Live, starting from 0.
+bool SimpleLive::nextTrigger(unsigned card, TriggerPoint & point, int & triggerValue) const {
+	const auto & skill = skills[card];
+	int v = skill.triggerValue;
+	while (point.chart < model.charts.size()) {
+		size_t k = point.chart;
+		const auto & chart = model.charts[k];
+		switch (model.cards[card].skill.trigger) {
+		case Skill::Trigger::Time:
+		{
+			double time = point.time + v;
+			if (time < chart.lastNoteShowTime) {
+				point = { k, time, hitsUntil(k, time) };
+				return true;
+			}
+			break;
+		}
+		case Skill::Trigger::NotesCount:
+		case Skill::Trigger::ComboCount:
+		{
+			bool isNotes = model.cards[card].skill.trigger == Skill::Trigger::NotesCount;
+			const auto eventTime = [&](int trigger) {
+				return isNotes ? chart.notes[trigger - chart.beginNote - 1].showTime : model.combos[trigger - 1];
+			};
+			int combo = comboBefore[k] + scoredBefore[k][point.hitEnd];
+			const auto satisfied = [&](int trigger) {
+				return isNotes ? !(trigger > chart.endNote) && point.time >= eventTime(trigger) : combo >= trigger;
+			};
+			int next = triggerValue + v;
+			if (next > chart.endNote) {
+				break;
+			}
+			if (!satisfied(next)) {
+				triggerValue = next;
+				double time = eventTime(next);
+				point = { k, time, hitsUntil(k, time) };
+				return true;
+			}
+			// Self-overlapping, the event is at the same time
+			while (satisfied(next + v)) {
+				next += v;
+			}
+			triggerValue = next;
+			return true;
+		}
+		case Skill::Trigger::PerfectCount:
+		case Skill::Trigger::StarPerfect:
+		{
+			// Fires at the hit reaching the trigger value, after the hits of the same time,
+			// and carries over to the next charts
+			const auto & counts = skill.isStarPerfect ? starPerfects : perfects;
+			int curr = counts.before(k, point.hitEnd);
+			int next = triggerValue + v;
+			if (curr >= next) {
+				while (curr >= next + v) {
+					next += v;
+				}
+				triggerValue = next;
+				return true;
+			}
+			triggerValue = next;
+			int hit;
+			if (!counts.find(next, k, k, hit)) {
+				return false;
+			}
+			point = { k, model.chartHits[k][hit].time, timeGroupEnds[k][hit] };
+			return true;
+		}
+		default:
+			return false;
+		}
+		// Live sets the trigger again when the next chart starts, before any hit
+		point = { k + 1, 0, 0 };
+	}
+	return false;
+}
+
+
+// Hits judged by an event at time, Live judges the hits of the same time first
+int SimpleLive::hitsUntil(size_t chart, double time) const {
+	const auto & hits = model.chartHits[chart];
+	auto it = upper_bound(hits.begin(), hits.end(), time, [](double t, const auto & hit) {
+		return t < hit.time;
+	});
+	return static_cast<int>(it - hits.begin());
+}
+
+
+void SimpleLive::PerfectCounts::count(const vector<vector<uint64_t>> & masks) {
+	this->masks = &masks;
+	wordsBefore.resize(masks.size());
+	int n = 0;
+	for (size_t k = 0; k < masks.size(); k++) {
+		auto & before = wordsBefore[k];
+		before.resize(masks[k].size() + 1);
+		for (size_t w = 0; w < masks[k].size(); w++) {
+			before[w] = n;
+			n += popCount64(masks[k][w]);
+		}
+		before.back() = n;
+	}
+}
+
+
+int SimpleLive::PerfectCounts::before(size_t chart, int hitEnd) const {
+	auto w = static_cast<size_t>(hitEnd >> 6);
+	int n = wordsBefore[chart][w];
+	if (hitEnd & 63) {
+		n += popCount64((*masks)[chart][w] & ((UINT64_C(1) << (hitEnd & 63)) - 1));
+	}
+	return n;
+}
+
+
+bool SimpleLive::PerfectCounts::find(int n, size_t from, size_t & chart, int & hit) const {
+	for (size_t k = from; k < wordsBefore.size(); k++) {
+		const auto & before = wordsBefore[k];
+		if (before.back() < n) {
+			continue;
+		}
+		// The last word with fewer than n perfects before it
+		auto w = static_cast<size_t>(lower_bound(before.begin(), before.end(), n) - before.begin() - 1);
+		chart = k;
+		hit = static_cast<int>(w << 6) + selectBit64((*masks)[k][w], n - 1 - before[w]);
+		return true;
+	}
+	return false;
+}
+
+
+int SimpleLive::countEvents(unsigned card) const {
+	const auto & skill = skills[card];
+	if (!skill.isPerfectTrigger) {
+		return skill.fixedEvents;
+	}
+	TriggerPoint point{};
+	int triggerValue = 0;
+	int events = 0;
+	while (nextTrigger(card, point, triggerValue)) {
+		events++;
+	}
+	return events;
+}
+
+
+// Every hit of a class is great independently like in HitJudge, hold ends
+// also depend on their hold begin, and every event rolls independently
+ScoreDistribution SimpleLive::distribution() const {
+	assert(supportsDistribution(model));
+	vector<vector<double>> greatRates;
+	for (const auto & hits : model.chartHits) {
+		greatRates.emplace_back(hits.size());
+	}
+	for (int c = 0; c < LiveModel::HIT_CLASS_NUM; c++) {
+		double p = model.greatGaps[c].p() > 0 ? min(model.greatGaps[c].p(), 1.) : 0;
+		for (const auto & ref : model.classHits[c]) {
+			greatRates[ref.chart][ref.hit] = p;
+		}
+	}
+
+	ScoreDistribution dist;
+	for (size_t k = 0; k < model.charts.size(); k++) {
+		const auto & hits = model.chartHits[k];
+		vector<double> holdBeginGreatRates(model.charts[k].notes.size());
+		for (size_t i = 0; i < hits.size(); i++) {
+			const auto & hit = hits[i];
+			double g = greatRates[k][i];
+			if (hit.isHoldBegin) {
+				holdBeginGreatRates[hit.noteIndex] = g;
+				continue;
+			}
+			// By [isPerfect * 2 + isHoldBeginPerfect], the begin of other notes counts as perfect
+			const auto & scores = hitScores[k][i];
+			const auto score = [&](int j) { return static_cast<int>(scores[j]); };
+			if (hit.isHoldEnd) {
+				double gb = holdBeginGreatRates[hit.noteIndex];
+				dist.add({
+					{ score(3), (1 - g) * (1 - gb) },
+					{ score(2), (1 - g) * gb },
+					{ score(1), g * (1 - gb) },
+					{ score(0), g * gb },
+				});
+			} else {
+				dist.add({ { score(3), 1 - g }, { score(1), g } });
+			}
+		}
+	}
+	for (const auto & skill : skills) {
+		if (skill.fixedEvents) {
+			dist.addBinomial(static_cast<int>(skill.effectValue), skill.fixedEvents, skill.activationPercent / 100.);
+		}
+	}
+	return dist;
+}
+
+
+LiveResult SimpleLive::simulate(uint64_t id, uint64_t seed) {
+	judge.judge(id, seed, ownJudgments);
+	return simulate(id, seed, ownJudgments);
+}
+
+
+// Note outcomes without perfect bonuses
+LiveResult SimpleLive::scoreNotes(const HitJudgments & hitJudgments) {
+	judgments = &hitJudgments;
+	perfects.count(judgments->perfectMasks);
+	starPerfects.count(judgments->starPerfectMasks);
+
+	double score = allPerfectScore;
+	for (size_t k = 0; k < model.charts.size(); k++) {
+		const auto & hits = model.chartHits[k];
+		const auto & scoredMask = model.chartPerfectMasks[k];
+		for (size_t w = 0; w < scoredMask.size(); w++) {
+			// Scored hits not counted as perfect: greats and hold ends after a great begin
+			for (uint64_t changed = scoredMask[w] & ~judgments->perfectMasks[k][w]; changed; changed &= changed - 1) {
+				int i = static_cast<int>(w << 6) + countTrailingZeros64(changed);
+				bool isPerfect = testBit(judgments->hitPerfects[k], i);
+				bool isHoldBeginPerfect = judgments->holdBeginPerfects[k][hits[i].noteIndex];
+				score += hitScores[k][i][isPerfect * 2 + isHoldBeginPerfect] - hitScores[k][i][3];
+			}
+		}
+	}
+
+	LiveResult result;
+	result.score = static_cast<int>(score);
+	result.logWeight = judgments->logWeight;
+	copy(judgments->classGreats.begin(), judgments->classGreats.end(), result.covariates.begin() + LiveResult::GREATS_FIRST);
+	return result;
+}
+
+
+// Each card rolls from its own stream like in Live
+void SimpleLive::seedActivations(unsigned card, uint64_t id, uint64_t seed) {
+	activationRng.seed(seed, antithetic ? id & ~UINT64_C(1) : id, card, antithetic && (id & 1),
+		qmc, activationTilt ? &*activationTilt : nullptr);
+}
+
+
+void SimpleLive::addActivations(unsigned card, int events, int activations, LiveResult & result) const {
+	const auto & skill = skills[card];
+	result.score += static_cast<int>(activations * skill.effectValue);
+	result.covariates[LiveResult::activationSlot(card)] += activations * 100 - events * skill.activationPercent;
+}
+
+
+// Replays the perfect bonus cards: a trigger rolls, an activation keeps the card
+// on for its duration and the next trigger is set when it ends. The bonus is
+// the sum of a queue of values which, like in Live, pops the oldest one
+// whichever card ends, so the notes between the events are scored again under
+// the queue replayed in Live's event order.
+void SimpleLive::playBonuses(uint64_t id, uint64_t seed, LiveResult & result) {
+	if (bonusCards.empty()) {
+		return;
+	}
+	bonusEvents.clear();
+	for (auto c : bonusCards) {
+		const auto & skill = skills[c];
+		seedActivations(c, id, seed);
+		TriggerPoint point{};
+		int triggerValue = 0;
+		int events = 0;
+		int activations = 0;
+		while (nextTrigger(c, point, triggerValue)) {
+			events++;
+			// Effectively ceil(rate * mod)
+			if (!activationRng.activate(skill.activationThreshold)) {
+				continue;
+			}
+			activations++;
+			bonusEvents.push_back({ point, true, c });
+			double offTime = point.time + skill.dischargeTime;
+			point = { point.chart, offTime, hitsUntil(point.chart, offTime) };
+			bonusEvents.push_back({ point, false, c });
+		}
+		result.covariates[LiveResult::activationSlot(c)] += activations * 100 - events * skill.activationPercent;
+		cardLogWeights[c] = activationRng.logWeight();
+	}
+	if (bonusEvents.empty()) {
+		return;
+	}
+
+	// Events of the same time are handled ends first, then in skill order
+	for (unsigned c = 0; c < skillOrder.size(); c++) {
+		skillOrder[c] = model.skillOrder.empty() ? c : static_cast<unsigned>(model.skillOrder[c]);
+	}
+	if (model.skillOrder.empty() && bonusCards.size() > 1) {
+		shuffleRng.seed(seed, antithetic ? id & ~UINT64_C(1) : id, CounterRandom::Purpose::Shuffle, 0,
+			antithetic && (id & 1));
+		for (auto i = static_cast<uint32_t>(skillOrder.size()); i > 1; --i) {
+			swap(skillOrder[i - 1], skillOrder[shuffleRng(i)]);
+		}
+	}
+	stable_sort(bonusEvents.begin(), bonusEvents.end(), [&](const BonusEvent & a, const BonusEvent & b) {
+		return tie(a.point.chart, a.point.time, a.isOn, skillOrder[a.card])
+			< tie(b.point.chart, b.point.time, b.isOn, skillOrder[b.card]);
+	});
+
+	double delta = 0;
+	double rate = 1;
+	int hitEnd = 0;
+	bonusQueue.clear();
+	for (const auto & event : bonusEvents) {
+		if (rate != 1) {
+			delta += bonusScoreDelta(event.point.chart, hitEnd, event.point.hitEnd, rate);
+		}
+		if (event.isOn) {
+			bonusQueue.push_back(skills[event.card].effectValue);
+		} else {
+			bonusQueue.pop_front();
+		}
+		rate = accumulate(bonusQueue.begin(), bonusQueue.end(), 1.0);
+		hitEnd = event.point.hitEnd;
+	}
+	assert(bonusQueue.empty());
+	result.score += static_cast<int>(delta);
+}
+
+
+// Score of hit i of chart under a perfect bonus rate, in the same operations as Live::computeScore
+double SimpleLive::hitScore(size_t chart, int i, bool isPerfect, bool isHoldBeginPerfect, double rate) const {
+	const auto & hit = model.chartHits[chart][i];
+	double noteScore = model.unitStatus;
+	noteScore *= isPerfect ? 1.25 : 1.1;
+	noteScore *= hitComboMuls[chart][i];
+	noteScore *= rate;
+	noteScore = model.chartNoteMuls[chart][hit.noteIndex].apply(noteScore, isHoldBeginPerfect);
+	noteScore = Floor(noteScore / 100.);
+	noteScore *= model.liveScoreRate;
+	return Ceil(noteScore);
+}
+
+
+// Scores of hits [first, last) under a perfect bonus rate less their scores without it
+double SimpleLive::bonusScoreDelta(size_t chart, int first, int last, double rate) const {
+	const auto & hits = model.chartHits[chart];
+	double delta = 0;
+	for (int i = first; i < last; i++) {
+		const auto & hit = hits[i];
+		if (hit.isHoldBegin) {
+			continue;
+		}
+		bool isPerfect = testBit(judgments->hitPerfects[chart], i);
+		bool isHoldBeginPerfect = judgments->holdBeginPerfects[chart][hit.noteIndex];
+		delta += hitScore(chart, i, isPerfect, isHoldBeginPerfect, rate)
+			- hitScores[chart][i][isPerfect * 2 + isHoldBeginPerfect];
+	}
+	return delta;
+}
+
+
+LiveResult SimpleLive::simulate(uint64_t id, uint64_t seed, const HitJudgments & hitJudgments) {
+	auto result = scoreNotes(hitJudgments);
+	fill(cardLogWeights.begin(), cardLogWeights.end(), 0.);
+	playBonuses(id, seed, result);
+	// Only the number of events of a ScorePlus card matters
+	for (auto c : scorePlusCards) {
+		int events = countEvents(c);
+		if (!events) {
+			continue;
+		}
+		seedActivations(c, id, seed);
+		int activations = 0;
+		for (int i = 0; i < events; i++) {
+			// Effectively ceil(rate * mod)
+			activations += activationRng.activate(skills[c].activationThreshold);
+		}
+		addActivations(c, events, activations, result);
+		cardLogWeights[c] = activationRng.logWeight();
+	}
+	// Summed in card order like Live
+	for (auto logWeight : cardLogWeights) {
+		result.logWeight += logWeight;
+	}
+	return result;
+}
+
+
+// The lives are judged and scored one by one, then the ScorePlus activations
+// of all lanes are rolled together
+void SimpleLive::simulate(uint64_t first, size_t n, uint64_t seed, LiveResult * results) {
+	assert(n <= LANES);
+	// QMC points and tilted rolls are drawn by ActivationRandom
+	if (qmc || activationTilt || n == 1) {
+		for (size_t j = 0; j < n; j++) {
+			results[j] = simulate(first + j, seed);
+		}
+		return;
+	}
+	LaneActivations::Ids streams = {};
+	unsigned complements = 0;
+	for (size_t j = 0; j < n; j++) {
+		uint64_t id = first + j;
+		streams[j] = antithetic ? id & ~UINT64_C(1) : id;
+		complements |= static_cast<unsigned>(antithetic && (id & 1)) << j;
+	}
+	for (auto & events : laneEvents) {
+		events.fill(0);
+	}
+	for (size_t j = 0; j < n; j++) {
+		judge.judge(first + j, seed, ownJudgments);
+		results[j] = scoreNotes(ownJudgments);
+		playBonuses(first + j, seed, results[j]);
+		for (size_t i = 0; i < scorePlusCards.size(); i++) {
+			laneEvents[i][j] = countEvents(scorePlusCards[i]);
+		}
+	}
+	for (size_t i = 0; i < scorePlusCards.size(); i++) {
+		unsigned c = scorePlusCards[i];
+		const auto & events = laneEvents[i];
+		laneActivations.seed(seed, c, streams, complements);
+		auto activations = laneActivations.count(skills[c].activationPercent, events);
+		for (size_t j = 0; j < n; j++) {
+			if (events[j]) {
+				addActivations(c, events[j], activations[j], results[j]);
+			}
+		}
+	}
+}
+#endif
@@ -0,0 +1,160 @@
+#pragma once
+#include "configure.h"
+
+#if !SIMULATE_HIT_TIMING
+#include <vector>
+#include <deque>
+#include <array>
+#include <cstdint>
+#include "livemodel.h"
+#include "judgment.h"
+#include "liveresult.h"
+#include "activation.h"
+#include "counterrandom.h"
+#include "laneactivation.h"
+#include "distribution.h"
+#include "optional.h"
+
+
+// Engine for units whose skills add score on the spot (immediate ScorePlus) or
+// raise note scores for a while (PerfectBonusRatio with a duration), triggered by
+// time, notes, combo, perfects or star perfects. Such skills never change what
+// triggers depend on, and every card rolls from its own stream, so a live
+// reduces to the note outcomes, a table of note scores, the number of events
+// of each ScorePlus card and the windows of each perfect bonus card. Results
+// are the same as Live for the same id.
+// simulate(first, n, ...) judges and scores up to LANES lives one by one, then
+// rolls their ScorePlus activations together, one SIMD lane per live.
+class SimpleLive {
+public:
+	static constexpr size_t LANES = LaneActivations::LANES;
+
+	// Whether the unit fits this engine
+	static bool supports(const LiveModel & model);
+	// Whether distribution() is exact for the unit: every event count is
+	// fixed, so the score is a sum of independent note outcomes and activations
+	static bool supportsDistribution(const LiveModel & model);
+
+	explicit SimpleLive(const LiveModel & model);
+	LiveResult simulate(uint64_t id, uint64_t seed = UINT64_C(0xcafef00dd15ea5e5));
+	LiveResult simulate(uint64_t id, uint64_t seed, const HitJudgments & hitJudgments);
+	// Lives [first, first + n) for n at most LANES, the same as simulate(id, seed) one by one
+	void simulate(uint64_t first, size_t n, uint64_t seed, LiveResult * results);
+
+	// Distribution of the score without simulating, supportsDistribution() shall hold
+	ScoreDistribution distribution() const;
+
+	// Same as Live::setAntithetic
+	void setAntithetic(bool value) {
+		antithetic = value;
+		judge.setAntithetic(value);
+	}
+
+	// Same as Live::setQmc
+	void setQmc(const QmcPoints * points) {
+		qmc = points;
+	}
+
+	// Same as Live::setTilt
+	void setTilt(double tilt) {
+		activationTilt.reset();
+		if (tilt != 0) {
+			activationTilt.emplace(tilt);
+		}
+		judge.setTilt(tilt);
+	}
+
+private:
+	struct SkillData {
+		double effectValue;
+		double activationThreshold;
+		int activationPercent;
+		int triggerValue;
+		bool isPerfectTrigger;
+		bool isStarPerfect;
+		bool isBonus;
+		double dischargeTime;
+		// Time, note and combo triggers of ScorePlus skills don't depend on the note outcomes
+		int fixedEvents;
+	};
+
+	// When Live handles an event: the chart, the time and the hits judged by then
+	struct TriggerPoint {
+		size_t chart;
+		double time;
+		int hitEnd;
+	};
+
+	// A perfect bonus card turning on or off
+	struct BonusEvent {
+		TriggerPoint point;
+		bool isOn;
+		unsigned card;
+	};
+
+	// Perfects (or star perfects) of an iteration counted per 64 hits, so that
+	// the hit reaching a count is found without scanning the masks
+	class PerfectCounts {
+	public:
+		void count(const std::vector<std::vector<uint64_t>> & masks);
+		// Perfects in the charts before chart and its first hitEnd hits
+		int before(size_t chart, int hitEnd) const;
+		// The hit bringing the perfects to n, in chart from or later
+		bool find(int n, size_t from, size_t & chart, int & hit) const;
+
+	private:
+		const std::vector<std::vector<uint64_t>> * masks = nullptr;
+		// Per chart, perfects before each word including the charts before
+		std::vector<std::vector<int>> wordsBefore;
+	};
+
+	void initScores();
+	void countFixedEvents();
+	bool nextTrigger(unsigned card, TriggerPoint & point, int & triggerValue) const;
+	int hitsUntil(size_t chart, double time) const;
+	LiveResult scoreNotes(const HitJudgments & hitJudgments);
+	int countEvents(unsigned card) const;
+	void seedActivations(unsigned card, uint64_t id, uint64_t seed);
+	void playBonuses(uint64_t id, uint64_t seed, LiveResult & result);
+	double hitScore(size_t chart, int i, bool isPerfect, bool isHoldBeginPerfect, double rate) const;
+	double bonusScoreDelta(size_t chart, int first, int last, double rate) const;
+	void addActivations(unsigned card, int events, int activations, LiveResult & result) const;
+
+	const LiveModel & model;
+	bool antithetic = false;
+	const QmcPoints * qmc = nullptr;
+	optional<ActivationTilt> activationTilt;
+	HitJudge judge;
+	HitJudgments ownJudgments;
+	ActivationRandom activationRng;
+	LaneActivations laneActivations;
+
+	// Per card, only cards with a valid skill are used
+	std::vector<SkillData> skills;
+	std::vector<unsigned> scorePlusCards;
+	std::vector<unsigned> bonusCards;
+
+	// Note scores of every hit by [isPerfect * 2 + isHoldBeginPerfect], and the sum if all are perfect
+	std::vector<std::vector<std::array<double, 4>>> hitScores;
+	double allPerfectScore = 0;
+	// Combo multiplier of every hit, for scores under perfect bonuses
+	std::vector<std::vector<double>> hitComboMuls;
+	// Per hit, the end of the hits with the same time
+	std::vector<std::vector<int>> timeGroupEnds;
+	// Per hit index, the number of scored hits before it
+	std::vector<std::vector<int>> scoredBefore;
+	// Per chart, the number of scored hits in the charts before it
+	std::vector<int> comboBefore;
+
+	// Per iteration
+	const HitJudgments * judgments = nullptr;
+	PerfectCounts perfects;
+	PerfectCounts starPerfects;
+	std::vector<BonusEvent> bonusEvents;
+	std::deque<double> bonusQueue;
+	std::vector<unsigned> skillOrder;
+	std::vector<double> cardLogWeights;
+	CounterRandom shuffleRng;
+	std::vector<LaneActivations::Counts> laneEvents;
+};
+#endif
@@ -0,0 +1,556 @@
+#include "statistics.h"
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <numeric>
+
+using namespace std;
+
+
+void ScoreHistogram::add(int score, uint64_t count) {
+	auto & page = pages[score >> PAGE_BITS];
+	if (page.empty()) {
+		page.resize(PAGE_SIZE);
+	}
+	page[score & (PAGE_SIZE - 1)] += count;
+	total += count;
+}
+
+
+void ScoreHistogram::merge(const ScoreHistogram & other) {
+	for (const auto & otherPage : other.pages) {
+		auto & page = pages[otherPage.first];
+		if (page.empty()) {
+			page = otherPage.second;
+		} else {
+			transform(page.begin(), page.end(), otherPage.second.begin(), page.begin(),
+				[](uint64_t a, uint64_t b) { return a + b; });
+		}
+	}
+	total += other.total;
+}
+
+
+void ScoreHistogram::clear() {
+	pages.clear();
+	total = 0;
+}
+
+
+int ScoreHistogram::nth(uint64_t k) const {
+	for (const auto & page : pages) {
+		for (int i = 0; i < PAGE_SIZE; i++) {
+			if (k < page.second[i]) {
+				return (page.first << PAGE_BITS) + i;
+			}
+			k -= page.second[i];
+		}
+	}
+	throw out_of_range("ScoreHistogram::nth");
+}
+
+
+double ScoreHistogram::mean() const {
+	double sum = 0;
+	forEach([&](int score, uint64_t count) {
+		sum += static_cast<double>(score) * count;
+	});
+	return sum / total;
+}
+
+
+double ScoreHistogram::variance() const {
+	double avg = mean();
+	double sum = 0;
+	forEach([&](int score, uint64_t count) {
+		double d = score - avg;
+		sum += d * d * count;
+	});
+	return sum / (total - 1);
+}
+
+
+pair<int, int> ScoreHistogram::quantileInterval(double q, double z) const {
+	double center = q * total;
+	double half = z * sqrt(total * q * (1 - q));
+	double maxRank = static_cast<double>(total - 1);
+	auto lower = static_cast<uint64_t>(std::min(std::max(floor(center - half), 0.), maxRank));
+	auto upper = static_cast<uint64_t>(std::min(std::max(ceil(center + half), 0.), maxRank));
+	return { nth(lower), nth(upper) };
+}
+
+
+ScoreStatistics::ScoreStatistics(uint64_t n, double mean, double m2, int minScore, int maxScore, ScoreHistogram hist)
+	: n(n), m(mean), m2(m2), minScore(minScore), maxScore(maxScore), hist(move(hist)) {
+	if (this->hist.count() != n) {
+		throw invalid_argument("ScoreStatistics: histogram doesn't match count");
+	}
+}
+
+
+void ScoreStatistics::add(int score) {
+	++n;
+	double d = score - m;
+	m += d / n;
+	m2 += d * (score - m);
+	minScore = std::min(minScore, score);
+	maxScore = std::max(maxScore, score);
+	hist.add(score);
+}
+
+
+void ScoreStatistics::merge(const ScoreStatistics & other) {
+	if (!other.n) {
+		return;
+	}
+	if (!n) {
+		*this = other;
+		return;
+	}
+	uint64_t total = n + other.n;
+	double d = other.m - m;
+	m += d * other.n / total;
+	m2 += other.m2 + d * d * n / total * other.n;
+	n = total;
+	minScore = std::min(minScore, other.minScore);
+	maxScore = std::max(maxScore, other.maxScore);
+	hist.merge(other.hist);
+}
+
+
+void ScoreStatistics::clear() {
+	*this = ScoreStatistics();
+}
+
+
+double ScoreStatistics::stddev() const {
+	return sqrt(variance());
+}
+
+
+void ExactMoments::add(int64_t x) {
+	uint64_t a = static_cast<uint64_t>(x < 0 ? -x : x);
+	uint64_t sq = a * a;
+	++n;
+	sum += x;
+	sumSqLow += sq;
+	sumSqHigh += sumSqLow < sq;
+}
+
+
+void ExactMoments::merge(const ExactMoments & other) {
+	n += other.n;
+	sum += other.sum;
+	sumSqLow += other.sumSqLow;
+	sumSqHigh += other.sumSqHigh + (sumSqLow < other.sumSqLow);
+}
+
+
+void ExactMoments::clear() {
+	*this = ExactMoments();
+}
+
+
+double ExactMoments::mean() const {
+	return static_cast<double>(sum) / n;
+}
+
+
+double ExactMoments::variance() const {
+	double sumSq = ldexp(static_cast<double>(sumSqHigh), 64) + static_cast<double>(sumSqLow);
+	double s = static_cast<double>(sum);
+	return std::max((sumSq - s * s / n) / (n - 1), 0.);
+}
+
+
+double ExactMoments::standardError() const {
+	return sqrt(variance() / n);
+}
+
+
+void ExactSum::addProduct(int64_t a, int64_t b) {
+	uint64_t m = static_cast<uint64_t>(a < 0 ? -a : a) * static_cast<uint64_t>(b < 0 ? -b : b);
+	if ((a < 0) != (b < 0)) {
+		high -= low < m;
+		low -= m;
+	} else {
+		low += m;
+		high += low < m;
+	}
+}
+
+
+double ExactSum::value() const {
+	// Converts the magnitude, -2^64 + low would cancel to a few bits
+	if (static_cast<int64_t>(high) < 0) {
+		uint64_t negLow = 0 - low;
+		uint64_t negHigh = ~high + (low == 0);
+		return -(ldexp(static_cast<double>(negHigh), 64) + static_cast<double>(negLow));
+	}
+	return ldexp(static_cast<double>(high), 64) + static_cast<double>(low);
+}
+
+
+ControlVariates::ControlVariates(vector<double> means)
+	: means(move(means))
+	, sumX(this->means.size())
+	, sumXY(this->means.size())
+	, sumXX(this->means.size() * (this->means.size() + 1) / 2) {
+}
+
+
+void ControlVariates::add(int64_t y, const int64_t * x) {
+	++n;
+	sumY.add(y);
+	sumYY.addProduct(y, y);
+	size_t k = 0;
+	for (size_t i = 0; i < means.size(); i++) {
+		sumX[i].add(x[i]);
+		sumXY[i].addProduct(x[i], y);
+		for (size_t j = 0; j <= i; j++) {
+			sumXX[k++].addProduct(x[i], x[j]);
+		}
+	}
+}
+
+
+void ControlVariates::merge(const ControlVariates & other) {
+	n += other.n;
+	sumY.merge(other.sumY);
+	sumYY.merge(other.sumYY);
+	for (size_t i = 0; i < sumX.size(); i++) {
+		sumX[i].merge(other.sumX[i]);
+		sumXY[i].merge(other.sumXY[i]);
+	}
+	for (size_t k = 0; k < sumXX.size(); k++) {
+		sumXX[k].merge(other.sumXX[k]);
+	}
+}
+
+
+void ControlVariates::clear() {
+	*this = ControlVariates(move(means));
+}
+
+
+// Least squares on the centered sums by Cholesky decomposition. Covariates
+// explained by the ones before them (e.g. constant ones) are left out.
+ControlVariates::Fit ControlVariates::fit() const {
+	size_t dim = means.size();
+	double count = static_cast<double>(n);
+	double sy = sumY.value();
+	double syy = sumYY.value() - sy * sy / count;
+	Fit result{ vector<double>(dim), syy };
+	vector<double> sx(dim);
+	for (size_t i = 0; i < dim; i++) {
+		sx[i] = sumX[i].value();
+	}
+	const auto cxx = [&](size_t i, size_t j) {
+		if (i < j) {
+			swap(i, j);
+		}
+		return sumXX[i * (i + 1) / 2 + j].value() - sx[i] * sx[j] / count;
+	};
+
+	vector<size_t> used;
+	vector<vector<double>> l;
+	vector<double> z;
+	for (size_t i = 0; i < dim; i++) {
+		double cii = cxx(i, i);
+		if (!(cii > 0) || n <= used.size() + 2) {
+			continue;
+		}
+		vector<double> row;
+		double d = cii;
+		for (size_t t = 0; t < used.size(); t++) {
+			double v = cxx(i, used[t]);
+			for (size_t s = 0; s < t; s++) {
+				v -= row[s] * l[t][s];
+			}
+			v /= l[t][t];
+			row.push_back(v);
+			d -= v * v;
+		}
+		if (!(d > cii * 1e-9)) {
+			continue;
+		}
+		row.push_back(sqrt(d));
+		// Forward substitution of the cross sums with y
+		double v = sumXY[i].value() - sx[i] * sy / count;
+		for (size_t s = 0; s < used.size(); s++) {
+			v -= row[s] * z[s];
+		}
+		z.push_back(v / row.back());
+		used.push_back(i);
+		l.push_back(move(row));
+	}
+
+	// Back substitution, the explained sum of squares is |z|^2
+	for (size_t t = used.size(); t-- > 0;) {
+		double v = z[t];
+		for (size_t s = t + 1; s < used.size(); s++) {
+			v -= l[s][t] * result.b[used[s]];
+		}
+		result.b[used[t]] = v / l[t][t];
+		result.residualVariance -= z[t] * z[t];
+	}
+	result.residualVariance = std::max(result.residualVariance, 0.) / (count - used.size() - 1);
+	return result;
+}
+
+
+double ControlVariates::mean() const {
+	auto b = coefficients();
+	double m = sumY.value() / n;
+	for (size_t i = 0; i < means.size(); i++) {
+		if (b[i] != 0) {
+			m -= b[i] * (sumX[i].value() / n - means[i]);
+		}
+	}
+	return m;
+}
+
+
+double ControlVariates::standardError() const {
+	return sqrt(fit().residualVariance / n);
+}
+
+
+vector<double> ControlVariates::coefficients() const {
+	return fit().b;
+}
+
+
+void ReplicateStatistics::merge(const ReplicateStatistics & other) {
+	for (size_t r = 0; r < replicates.size(); r++) {
+		replicates[r].n += other.replicates[r].n;
+		replicates[r].sum += other.replicates[r].sum;
+	}
+}
+
+
+void ReplicateStatistics::clear() {
+	fill(replicates.begin(), replicates.end(), Replicate());
+}
+
+
+double ReplicateStatistics::standardError() const {
+	vector<double> means;
+	for (const auto & r : replicates) {
+		means.push_back(static_cast<double>(r.sum) / r.n);
+	}
+	double k = static_cast<double>(means.size());
+	double mean = accumulate(means.begin(), means.end(), 0.) / k;
+	double sumSq = 0;
+	for (double m : means) {
+		sumSq += (m - mean) * (m - mean);
+	}
+	return sqrt(sumSq / (k - 1) / k);
+}
+
+
+void WeightSum::add(double x) {
+	if (!(x > 0)) {
+		return;
+	}
+	if (isinf(x)) {
+		throw runtime_error("Importance weight out of range");
+	}
+	// x = m * 2^low with an integer m < 2^53
+	int e;
+	frexp(x, &e);
+	int low = max(e - 53, -1074);
+	auto m = static_cast<uint64_t>(ldexp(x, -low));
+	int bit = low + 1074;
+	auto word = static_cast<size_t>(bit >> 6);
+	int shift = bit & 63;
+	addWord(word, m << shift);
+	if (shift > 64 - 53) {
+		addWord(word + 1, m >> (64 - shift));
+	}
+}
+
+
+void WeightSum::addWord(size_t word, uint64_t x) {
+	if (!x) {
+		return;
+	}
+	if (words.empty()) {
+		first = word;
+	} else if (word < first) {
+		words.insert(words.begin(), first - word, 0);
+		first = word;
+	}
+	for (size_t i = word - first; x; i++) {
+		if (i == words.size()) {
+			words.push_back(0);
+		}
+		words[i] += x;
+		// Carry
+		x = words[i] < x;
+	}
+}
+
+
+void WeightSum::merge(const WeightSum & other) {
+	for (size_t i = 0; i < other.words.size(); i++) {
+		addWord(other.first + i, other.words[i]);
+	}
+}
+
+
+// The highest word is never 0, and the three highest hold more bits than a double
+double WeightSum::value() const {
+	double sum = 0;
+	for (size_t i = words.size(); i-- > 0 && i + 3 >= words.size();) {
+		sum += ldexp(static_cast<double>(words[i]), static_cast<int>(64 * (first + i)) - 1074);
+	}
+	return sum;
+}
+
+
+void WeightedScores::add(int score, double weight) {
+	auto & page = pages[score >> PAGE_BITS];
+	if (page.empty()) {
+		page.resize(PAGE_SIZE);
+	}
+	auto & bin = page[score & (PAGE_SIZE - 1)];
+	bin.count++;
+	bin.weights.add(weight);
+	bin.squares.add(weight * weight);
+	total++;
+}
+
+
+void WeightedScores::merge(const WeightedScores & other) {
+	for (const auto & otherPage : other.pages) {
+		auto & page = pages[otherPage.first];
+		if (page.empty()) {
+			page = otherPage.second;
+			continue;
+		}
+		for (int i = 0; i < PAGE_SIZE; i++) {
+			const auto & otherBin = otherPage.second[i];
+			page[i].count += otherBin.count;
+			page[i].weights.merge(otherBin.weights);
+			page[i].squares.merge(otherBin.squares);
+		}
+	}
+	total += other.total;
+}
+
+
+void WeightedScores::clear() {
+	pages.clear();
+	total = 0;
+}
+
+
+double WeightedScores::weightSum() const {
+	double sum = 0;
+	forEach([&](int, double weights, double) {
+		sum += weights;
+	});
+	return sum;
+}
+
+
+double WeightedScores::mean() const {
+	double sum = 0;
+	forEach([&](int score, double weights, double) {
+		sum += weights * score;
+	});
+	return sum / weightSum();
+}
+
+
+double WeightedScores::stddev() const {
+	double m = mean();
+	double sum = 0;
+	forEach([&](int score, double weights, double) {
+		sum += weights * (score - m) * (score - m);
+	});
+	return sqrt(sum / weightSum());
+}
+
+
+// Sum of (w (y - mean))^2 over the samples
+double WeightedScores::standardError() const {
+	double m = mean();
+	double sum = 0;
+	forEach([&](int score, double, double squares) {
+		sum += squares * (score - m) * (score - m);
+	});
+	return sqrt(sum) / weightSum();
+}
+
+
+double WeightedScores::effectiveCount() const {
+	double sumSq = 0;
+	forEach([&](int, double, double squares) {
+		sumSq += squares;
+	});
+	double sum = weightSum();
+	return sum * sum / sumSq;
+}
+
+
+int WeightedScores::quantile(double q) const {
+	double target = q * weightSum();
+	double cumulative = 0;
+	int found = INT_MIN;
+	int last = INT_MIN;
+	forEach([&](int score, double weights, double) {
+		cumulative += weights;
+		if (found == INT_MIN && cumulative >= target) {
+			found = score;
+		}
+		last = score;
+	});
+	// Rounding left the sum a little short of q = 1
+	return found != INT_MIN ? found : last;
+}
+
+
+pair<int, int> WeightedScores::quantileInterval(double q, double z) const {
+	int x = quantile(q);
+	// Variance of the distribution function at x, sum of w^2 (1{y <= x} - q)^2 / (sum of w)^2
+	double sum = 0;
+	forEach([&](int score, double, double squares) {
+		double d = (score <= x) - q;
+		sum += squares * d * d;
+	});
+	double se = sqrt(sum) / weightSum();
+	return { quantile(max(q - z * se, 0.)), quantile(min(q + z * se, 1.)) };
+}
+
+
+double MeanStandardError(const ScoreStatistics & stats, const MeanEstimators & estimators) {
+	if (estimators.weighted) {
+		return estimators.weighted->standardError();
+	}
+	if (estimators.controlVariates) {
+		return estimators.controlVariates->standardError() / (estimators.pairSums ? 2 : 1);
+	}
+	if (estimators.replicates) {
+		return estimators.replicates->standardError();
+	}
+	if (estimators.pairSums) {
+		return estimators.pairSums->standardError() / 2;
+	}
+	const auto & hist = stats.histogram();
+	return sqrt(hist.variance() / hist.count());
+}
+
+
+pair<double, double> WilsonInterval(uint64_t successes, uint64_t n, double z) {
+	if (n == 0) {
+		return { 0., 1. };
+	}
+	double p = static_cast<double>(successes) / n;
+	double z2 = z * z / n;
+	double center = (p + z2 / 2) / (1 + z2);
+	double half = z * sqrt(p * (1 - p) / n + z2 / (4 * n)) / (1 + z2);
+	return { max(center - half, 0.), min(center + half, 1.) };
+}
@@ -0,0 +1,402 @@
+#pragma once
+#include "configure.h"
+
+#include <vector>
+#include <map>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+#include <climits>
+
+
+// Standard normal quantile for 95% confidence intervals
+constexpr double Z_95 = 1.959963984540054;
+
+
+// Rank of the 0.1% score, same as nth_element(end - n / 1000)
+inline uint64_t TopRank(uint64_t n) {
+	return n - n / 1000;
+}
+
+// Fraction of the scores in the reported tails, 0.1% and Low 0.1%
+constexpr double TAIL_FRACTION = 0.001;
+
+
+// Exact histogram of integer scores.
+// Counts are kept in fixed size pages, so memory follows the occupied score range.
+class ScoreHistogram {
+public:
+	void add(int score, uint64_t count = 1);
+	void merge(const ScoreHistogram & other);
+	void clear();
+
+	uint64_t count() const {
+		return total;
+	}
+
+	// Score of the k-th smallest sample (0-based), requires k < count()
+	int nth(uint64_t k) const;
+
+	// Summed in score order, so unlike Welford merges the result
+	// doesn't depend on how samples were split between threads
+	double mean() const;
+	double variance() const;
+
+	// Distribution-free confidence interval of the q-quantile,
+	// z: standard normal quantile of the confidence level
+	std::pair<int, int> quantileInterval(double q, double z) const;
+
+	// Calls func(score, count) for every occupied score in ascending order
+	template <class Func>
+	void forEach(Func func) const {
+		for (const auto & page : pages) {
+			int base = page.first << PAGE_BITS;
+			for (int i = 0; i < PAGE_SIZE; i++) {
+				if (page.second[i]) {
+					func(base + i, page.second[i]);
+				}
+			}
+		}
+	}
+
+private:
+	static constexpr int PAGE_BITS = 10;
+	static constexpr int PAGE_SIZE = 1 << PAGE_BITS;
+
+	std::map<int, std::vector<uint64_t>> pages;
+	uint64_t total = 0;
+};
+
+
+// Streaming score statistics, mergeable across threads.
+// Mean and variance are accumulated with Welford's algorithm.
+class ScoreStatistics {
+public:
+	ScoreStatistics() = default;
+	// Restores saved statistics, m2: sum of squared deviations from the mean
+	ScoreStatistics(uint64_t n, double mean, double m2, int minScore, int maxScore, ScoreHistogram hist);
+
+	void add(int score);
+	void merge(const ScoreStatistics & other);
+	void clear();
+
+	uint64_t count() const {
+		return n;
+	}
+
+	double mean() const {
+		return m;
+	}
+
+	// Sample variance
+	double variance() const {
+		return m2 / (n - 1);
+	}
+
+	double stddev() const;
+
+	double sumSquaredDeviations() const {
+		return m2;
+	}
+
+	int min() const {
+		return minScore;
+	}
+
+	int max() const {
+		return maxScore;
+	}
+
+	const ScoreHistogram & histogram() const {
+		return hist;
+	}
+
+private:
+	uint64_t n = 0;
+	double m = 0;
+	double m2 = 0;
+	int minScore = INT_MAX;
+	int maxScore = INT_MIN;
+	ScoreHistogram hist;
+};
+
+
+// Mean and variance of integer samples, |x| < 2^32. Sums are kept as exact
+// integers, so the result doesn't depend on how samples were split between threads.
+class ExactMoments {
+public:
+	void add(int64_t x);
+	void merge(const ExactMoments & other);
+	void clear();
+
+	uint64_t count() const {
+		return n;
+	}
+
+	double mean() const;
+	// Sample variance
+	double variance() const;
+	// Standard error of mean()
+	double standardError() const;
+
+private:
+	uint64_t n = 0;
+	int64_t sum = 0;
+	// Sum of squares as a 128-bit integer
+	uint64_t sumSqLow = 0;
+	uint64_t sumSqHigh = 0;
+};
+
+
+// Statistics of the score differences a - b of two lives simulated with the same ids
+class PairedStatistics {
+public:
+	void add(int a, int b) {
+		diffs.add(static_cast<int64_t>(a) - b);
+		wins += a > b;
+	}
+
+	void merge(const PairedStatistics & other) {
+		diffs.merge(other.diffs);
+		wins += other.wins;
+	}
+
+	void clear() {
+		*this = PairedStatistics();
+	}
+
+	uint64_t count() const {
+		return diffs.count();
+	}
+
+	double mean() const {
+		return diffs.mean();
+	}
+
+	double standardError() const {
+		return diffs.standardError();
+	}
+
+	// Fraction of ids with a > b
+	double winRate() const {
+		return static_cast<double>(wins) / count();
+	}
+
+private:
+	ExactMoments diffs;
+	uint64_t wins = 0;
+};
+
+
+// Exact sum of 64-bit integers as a 128-bit two's complement integer
+class ExactSum {
+public:
+	void add(int64_t x) {
+		uint64_t u = static_cast<uint64_t>(x);
+		low += u;
+		high += (low < u) + (x < 0 ? ~UINT64_C(0) : 0);
+	}
+
+	// Adds a * b, |a| and |b| shall be less than 2^32
+	void addProduct(int64_t a, int64_t b);
+
+	void merge(const ExactSum & other) {
+		low += other.low;
+		high += other.high + (low < other.low);
+	}
+
+	double value() const;
+
+private:
+	uint64_t low = 0;
+	uint64_t high = 0;
+};
+
+
+// Mean of y corrected by control variates: covariates x with known means whose
+// deviations predict the deviation of y. The coefficients are fitted by least
+// squares, mean = mean(y) - b . (mean(x) - known means). Sums are exact like
+// ExactMoments, |y| and |x| shall be less than 2^32.
+class ControlVariates {
+public:
+	ControlVariates() = default;
+	explicit ControlVariates(std::vector<double> means);
+
+	void add(int64_t y, const int64_t * x);
+	void merge(const ControlVariates & other);
+	// Keeps the known means
+	void clear();
+
+	uint64_t count() const {
+		return n;
+	}
+
+	size_t size() const {
+		return means.size();
+	}
+
+	double mean() const;
+	// Standard error of mean(), from the residual variance of the fit
+	double standardError() const;
+	// Fitted coefficients, 0 for covariates left out as constant or collinear
+	std::vector<double> coefficients() const;
+
+private:
+	struct Fit {
+		std::vector<double> b;
+		double residualVariance;
+	};
+
+	Fit fit() const;
+
+	std::vector<double> means;
+	uint64_t n = 0;
+	ExactSum sumY;
+	ExactSum sumYY;
+	std::vector<ExactSum> sumX;
+	std::vector<ExactSum> sumXY;
+	// Lower triangle, [i * (i + 1) / 2 + j] for j <= i
+	std::vector<ExactSum> sumXX;
+};
+
+
+// Score sums of independent replicates, e.g. randomized QMC point sets, whose
+// iterations are not independent within a replicate. The standard error of
+// the mean comes from the spread of the replicate means.
+class ReplicateStatistics {
+public:
+	explicit ReplicateStatistics(unsigned replicates = 0) : replicates(replicates) {}
+
+	void add(unsigned replicate, int score) {
+		auto & r = replicates[replicate];
+		++r.n;
+		r.sum += score;
+	}
+
+	void merge(const ReplicateStatistics & other);
+	// Keeps the number of replicates
+	void clear();
+
+	size_t size() const {
+		return replicates.size();
+	}
+
+	double standardError() const;
+
+private:
+	struct Replicate {
+		uint64_t n = 0;
+		int64_t sum = 0;
+	};
+
+	std::vector<Replicate> replicates;
+};
+
+
+// Exact sum of non-negative doubles, kept as a fixed-point number on a grid
+// of 64-bit words from the smallest subnormal up, so the sum doesn't depend
+// on the order of the terms. Only the words in use are stored.
+class WeightSum {
+public:
+	void add(double x);
+	void merge(const WeightSum & other);
+
+	// The same for the same sum
+	double value() const;
+
+private:
+	void addWord(size_t word, uint64_t x);
+
+	// words[i] holds bits 64 * (first + i) and up, in units of 2^-1074
+	size_t first = 0;
+	std::vector<uint64_t> words;
+};
+
+
+// Scores with importance weights, the likelihood ratios of the sampled
+// outcomes. Estimates are self-normalized by the sum of the weights. The
+// count and the exact sums of the weights and of their squares are kept per
+// score in pages like ScoreHistogram and summed in score order, so the
+// results don't depend on how samples were split between threads.
+class WeightedScores {
+public:
+	void add(int score, double weight);
+	void merge(const WeightedScores & other);
+	void clear();
+
+	uint64_t count() const {
+		return total;
+	}
+
+	double mean() const;
+	double stddev() const;
+	// Standard error of mean() by the delta method
+	double standardError() const;
+	// Number of unweighted samples that would give about the same precision
+	double effectiveCount() const;
+
+	// Smallest score whose weighted distribution function reaches q, requires count() > 0
+	int quantile(double q) const;
+	// Confidence interval of quantile(q) from the standard error of the
+	// distribution function at it, z: standard normal quantile of the confidence level
+	std::pair<int, int> quantileInterval(double q, double z) const;
+
+private:
+	static constexpr int PAGE_BITS = 10;
+	static constexpr int PAGE_SIZE = 1 << PAGE_BITS;
+
+	struct Bin {
+		uint64_t count = 0;
+		WeightSum weights;
+		WeightSum squares;
+	};
+
+	// Calls func(score, sum of weights, sum of squared weights) for every occupied score in ascending order
+	template <class Func>
+	void forEach(Func func) const {
+		for (const auto & page : pages) {
+			int base = page.first << PAGE_BITS;
+			for (int i = 0; i < PAGE_SIZE; i++) {
+				const auto & bin = page.second[i];
+				if (bin.count) {
+					func(base + i, bin.weights.value(), bin.squares.value());
+				}
+			}
+		}
+	}
+
+	double weightSum() const;
+
+	std::map<int, std::vector<Bin>> pages;
+	uint64_t total = 0;
+};
+
+
+// Estimators filled alongside the score statistics, each optional
+struct MeanEstimators {
+	// Score sums of antithetic pairs
+	ExactMoments * pairSums = nullptr;
+	// Scores and covariates, of pairs if antithetic
+	ControlVariates * controlVariates = nullptr;
+	// Scores by QMC replicate
+	ReplicateStatistics * replicates = nullptr;
+	// Scores and weights of importance sampling with this tilt, see Live::setTilt
+	WeightedScores * weighted = nullptr;
+	double tilt = 0;
+	// Lives stop once whether they reach this score is known, see
+	// Live::setThreshold, so the scores are only good for that. 0 for none.
+	int threshold = 0;
+};
+
+
+// Standard error of the mean score. With antithetic sampling the scores of a
+// pair are not independent, so it comes from the score sums of the pairs, and
+// with QMC from the replicate means. With control variates it is that of the
+// corrected mean, which is fitted to pair sums too with antithetic sampling.
+// With importance sampling it is that of the weighted mean.
+double MeanStandardError(const ScoreStatistics & stats, const MeanEstimators & estimators = {});
+
+
+// Wilson score interval of a binomial proportion, which stays within [0, 1]
+// and holds up with few or no successes
+std::pair<double, double> WilsonInterval(uint64_t successes, uint64_t n, double z);
@@ -3,12 +3,15 @@
 
 #include "nativechar.h"
 #include <string>
+#include <vector>
 #include <cstdio>
+#include <cstdint>
 #include <iterator>
 #include <queue>
 #include <utility>
 #include <type_traits>
 #include <stdexcept>
+#include <cmath>
 
 
 #define MACRO_STRING_1(x) #x
@@ -39,6 +42,74 @@ private:
 };
 
 
+inline bool fileExists(const char * filename) {
+	std::FILE * fp = NativeFopen(ToNative(filename).c_str(), ToNative("rb").c_str());
+	if (fp) {
+		std::fclose(fp);
+	}
+	return fp != nullptr;
+}
+
+
+// Replaces to with from, atomically where the platform allows
+inline void replaceFile(const char * from, const char * to) {
+	auto nativeFrom = ToNative(from);
+	auto nativeTo = ToNative(to);
+	if (NativeRename(nativeFrom.c_str(), nativeTo.c_str()) != 0) {
+		// Windows doesn't rename over an existing file
+		NativeRemove(nativeTo.c_str());
+		if (NativeRename(nativeFrom.c_str(), nativeTo.c_str()) != 0) {
+			throw std::runtime_error("Cannot rename file");
+		}
+	}
+}
+
+
+// Modification time and size of a file, to tell cheaply whether it may have changed
+struct FileStamp {
+	int64_t mtime;
+	int64_t size;
+
+	bool operator==(const FileStamp & other) const {
+		return mtime == other.mtime && size == other.size;
+	}
+};
+
+inline FileStamp fileStamp(const char * filename) {
+	NativeStatBuf buf;
+	if (NativeStat(ToNative(filename).c_str(), &buf) != 0) {
+		throw std::runtime_error("Cannot open file");
+	}
+	return { static_cast<int64_t>(buf.st_mtime), static_cast<int64_t>(buf.st_size) };
+}
+
+
+// Reads the rest of fp
+inline std::string readAll(std::FILE * fp) {
+	std::string content;
+	char buf[0x1000];
+	size_t n;
+	while ((n = std::fread(buf, 1, sizeof(buf), fp)) != 0) {
+		content.append(buf, n);
+	}
+	if (std::ferror(fp)) {
+		throw std::runtime_error("Cannot read file");
+	}
+	return content;
+}
+
+
+// 64-bit FNV-1a
+inline uint64_t hashFnv1a(const std::string & data) {
+	uint64_t h = UINT64_C(0xcbf29ce484222325);
+	for (unsigned char c : data) {
+		h ^= c;
+		h *= UINT64_C(0x100000001b3);
+	}
+	return h;
+}
+
+
 template <class Compare>
 class ReverseComparer {
 public:
@@ -109,6 +180,106 @@ typename std::enable_if<
 }
 
 
+// Bit sets stored as 64-bit words, bit i of the set is bit i % 64 of word i / 64
+#if defined(_MSC_VER)
+#include <intrin.h>
+inline int popCount64(uint64_t x) {
+	return static_cast<int>(__popcnt64(x));
+}
+
+inline int countTrailingZeros64(uint64_t x) {
+	unsigned long i;
+	_BitScanForward64(&i, x);
+	return static_cast<int>(i);
+}
+#else
+inline int popCount64(uint64_t x) {
+	return __builtin_popcountll(x);
+}
+
+inline int countTrailingZeros64(uint64_t x) {
+	return __builtin_ctzll(x);
+}
+#endif
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+// Position of the (k+1)-th set bit of x, requires popCount64(x) > k
+inline int selectBit64(uint64_t x, int k) {
+#if defined(__BMI2__)
+	return countTrailingZeros64(_pdep_u64(UINT64_C(1) << k, x));
+#else
+	for (; k > 0; k--) {
+		x &= x - 1;
+	}
+	return countTrailingZeros64(x);
+#endif
+}
+
+inline bool testBit(const std::vector<uint64_t> & bits, int i) {
+	return bits[i >> 6] >> (i & 63) & 1;
+}
+
+inline void setBit(std::vector<uint64_t> & bits, int i) {
+	bits[i >> 6] |= UINT64_C(1) << (i & 63);
+}
+
+inline void resetBit(std::vector<uint64_t> & bits, int i) {
+	bits[i >> 6] &= ~(UINT64_C(1) << (i & 63));
+}
+
+// Number of set bits in [first, last)
+inline int countBits(const std::vector<uint64_t> & bits, int first, int last) {
+	if (first >= last) {
+		return 0;
+	}
+	int w = first >> 6;
+	int lastWord = (last - 1) >> 6;
+	uint64_t word = bits[w] & (~UINT64_C(0) << (first & 63));
+	int n = 0;
+	for (; w < lastWord; word = bits[++w]) {
+		n += popCount64(word);
+	}
+	int rest = last & 63;
+	if (rest) {
+		word &= (UINT64_C(1) << rest) - 1;
+	}
+	return n + popCount64(word);
+}
+
+// Position of the (k+1)-th set bit at or after first, -1 if there are not so many
+inline int findNthBit(const std::vector<uint64_t> & bits, int first, int k) {
+	int w = first >> 6;
+	if (w >= static_cast<int>(bits.size())) {
+		return -1;
+	}
+	uint64_t word = bits[w] & (~UINT64_C(0) << (first & 63));
+	for (;;) {
+		int n = popCount64(word);
+		if (k < n) {
+			return (w << 6) + selectBit64(word, k);
+		}
+		k -= n;
+		if (++w == static_cast<int>(bits.size())) {
+			return -1;
+		}
+		word = bits[w];
+	}
+}
+
+
+// p with its odds multiplied by e^tilt
+inline double tiltProbability(double p, double tilt) {
+	if (!(p > 0 && p < 1)) {
+		return p;
+	}
+	double r = p * std::exp(tilt);
+	return r / (1 - p + r);
+}
+
+
 #if USE_SSE_4_1_ROUND
 #include <smmintrin.h>
 inline double Floor(double x) {